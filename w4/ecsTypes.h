@@ -150,9 +150,22 @@ struct DungeonData
 struct DijkstraMapData
 {
   std::vector<float> map;
+  size_t version = 0;
 };
 
-struct VisualiseMap {};
+struct MapLabel
+{
+  float x = 0.f;
+  float y = 0.f;
+  char text[12] = {};
+};
+
+// debug overlay, labels are formatted once per map version and then only redrawn
+struct VisualiseMap
+{
+  std::vector<MapLabel> labels;
+  size_t version = size_t(-1);
+};
 
 struct DmapWeights
 {
@@ -8,6 +8,7 @@
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
 #include "dmapFollower.h"
+#include <cstdio> // snprintf
 
 static flecs::entity create_player_approacher(flecs::entity e)
 {
@@ -181,6 +182,20 @@ static void create_powerup(flecs::world &ecs, int x, int y, float amount)
     .set(Color{0xff, 0xff, 0x00, 0xff});
 }
 
+static void push_map_label(VisualiseMap &vis, size_t x, size_t y, float val)
+{
+  MapLabel &label = vis.labels.emplace_back();
+  label.x = (float(x) + 0.2f) * tile_size;
+  label.y = (float(y) + 0.5f) * tile_size;
+  snprintf(label.text, sizeof(label.text), "%.1f", val);
+}
+
+static void draw_map_labels(const VisualiseMap &vis)
+{
+  for (const MapLabel &label : vis.labels)
+    DrawText(label.text, label.x, label.y, 150, WHITE);
+}
+
 static void register_roguelike_systems(flecs::world &ecs)
 {
   static auto dungeonDataQuery = ecs.query<const DungeonData>();
@@ -254,47 +269,62 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       SetTextureFilter(tex, TEXTURE_FILTER_POINT);
     });
-  ecs.system<const DmapWeights>()
-    .term<VisualiseMap>()
-    .each([&](const DmapWeights &wt)
+  ecs.system<const DmapWeights, VisualiseMap>()
+    .each([&](const DmapWeights &wt, VisualiseMap &vis)
     {
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
+        std::vector<std::pair<const DijkstraMapData *, DmapWeights::WtData>> maps;
+        size_t version = 0;
+        for (const auto &pair : wt.weights)
+        {
+          const DijkstraMapData *dmap = ecs.entity(pair.first.c_str()).get<DijkstraMapData>();
+          if (!dmap)
+            continue;
+          version = version * 31 + dmap->version;
+          maps.emplace_back(dmap, pair.second);
+        }
+        if (version != vis.version)
+        {
+          vis.version = version;
+          vis.labels.clear();
+          for (size_t y = 0; y < dd.height; ++y)
+            for (size_t x = 0; x < dd.width; ++x)
             {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
+              float sum = 0.f;
+              for (const auto &[dmap, wtData] : maps)
               {
-                float v = dmap.map[y * dd.width + x];
+                float v = dmap->map[y * dd.width + x];
                 if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
+                  sum += powf(v * wtData.mult, wtData.pow);
                 else
                   sum += v;
-              });
+              }
+              if (sum < 1e5f)
+                push_map_label(vis, x, y, sum);
             }
-            if (sum < 1e5f)
-              DrawText(TextFormat("%.1f", sum),
-                  (float(x) + 0.2f) * tile_size, (float(y) + 0.5f) * tile_size, 150, WHITE);
-          }
+        }
+        draw_map_labels(vis);
       });
     });
-  ecs.system<const DijkstraMapData>()
-    .term<VisualiseMap>()
-    .each([](const DijkstraMapData &dmap)
+  ecs.system<const DijkstraMapData, VisualiseMap>()
+    .each([](const DijkstraMapData &dmap, VisualiseMap &vis)
     {
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
-        for (size_t y = 0; y < dd.height; ++y)
-          for (size_t x = 0; x < dd.width; ++x)
-          {
-            const float val = dmap.map[y * dd.width + x];
-            if (val < 1e5f)
-              DrawText(TextFormat("%.1f", val),
-                  (float(x) + 0.2f) * tile_size, (float(y) + 0.5f) * tile_size, 150, WHITE);
-          }
+        if (dmap.version != vis.version)
+        {
+          vis.version = dmap.version;
+          vis.labels.clear();
+          for (size_t y = 0; y < dd.height; ++y)
+            for (size_t x = 0; x < dd.width; ++x)
+            {
+              const float val = dmap.map[y * dd.width + x];
+              if (val < 1e5f)
+                push_map_label(vis, x, y, val);
+            }
+        }
+        draw_map_labels(vis);
       });
     });
 }
@@ -555,20 +585,24 @@ void process_turn(flecs::world &ecs)
     }
     process_actions(ecs);
 
+    // maps only change here, overlays use the version to know when to rebuild their labels
+    static size_t dmapVersion = 0;
+    dmapVersion++;
+
     std::vector<float> approachMap;
     dmaps::gen_player_approach_map(ecs, approachMap);
     ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
+      .set(DijkstraMapData{approachMap, dmapVersion});
 
     std::vector<float> fleeMap;
     dmaps::gen_player_flee_map(ecs, fleeMap);
     ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
+      .set(DijkstraMapData{fleeMap, dmapVersion});
 
     std::vector<float> hiveMap;
     dmaps::gen_hive_pack_map(ecs, hiveMap);
     ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+      .set(DijkstraMapData{hiveMap, dmapVersion});
 
     //ecs.entity("flee_map").add<VisualiseMap>();
     ecs.entity("hive_follower_sum")
@@ -0,0 +1,167 @@
+#include "allocTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <raylib.h>
+
+namespace
+{
+  std::atomic<uint64_t> counts[ALLOC_TAG_NUM];
+  std::atomic<uint64_t> bytes[ALLOC_TAG_NUM];
+  std::atomic<uint64_t> violations = 0;
+  alloc::TagStats lastFrame[ALLOC_TAG_NUM];
+  bool overlayEnabled = false;
+
+  thread_local AllocTag currentTag = ALLOC_UNTAGGED;
+  thread_local const char *zeroAllocName = nullptr;
+
+  void on_alloc(size_t size)
+  {
+    counts[currentTag].fetch_add(1, std::memory_order_relaxed);
+    bytes[currentTag].fetch_add(size, std::memory_order_relaxed);
+    if (!zeroAllocName)
+      return;
+    violations.fetch_add(1, std::memory_order_relaxed);
+#if !defined(NDEBUG)
+    const char *name = zeroAllocName;
+    zeroAllocName = nullptr; // the report below must not recurse into here
+    fprintf(stderr, "allocation of %zu bytes inside zero-alloc scope '%s'\n", size, name);
+    abort();
+#endif
+  }
+
+  void *alloc_or_throw(size_t size)
+  {
+    on_alloc(size);
+    if (void *p = malloc(size ? size : 1))
+      return p;
+    throw std::bad_alloc();
+  }
+
+  void *aligned_alloc_or_throw(size_t size, std::align_val_t al)
+  {
+    on_alloc(size);
+    const size_t align = size_t(al);
+#if defined(_MSC_VER)
+    if (void *p = _aligned_malloc(size ? size : 1, align))
+      return p;
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment, and a zero size may give null
+    const size_t rounded = (std::max(size, size_t(1)) + align - 1) / align * align;
+    if (void *p = aligned_alloc(align, rounded))
+      return p;
+#endif
+    throw std::bad_alloc();
+  }
+
+  void aligned_free(void *p)
+  {
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+  }
+}
+
+void *operator new(size_t size) { return alloc_or_throw(size); }
+void *operator new[](size_t size) { return alloc_or_throw(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  on_alloc(size);
+  return malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  on_alloc(size);
+  return malloc(size ? size : 1);
+}
+void *operator new(size_t size, std::align_val_t al) { return aligned_alloc_or_throw(size, al); }
+void *operator new[](size_t size, std::align_val_t al) { return aligned_alloc_or_throw(size, al); }
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { aligned_free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { aligned_free(p); }
+
+AllocTag alloc::current_tag()
+{
+  return currentTag;
+}
+
+const char *alloc::tag_name(AllocTag tag)
+{
+  static const char *names[ALLOC_TAG_NUM] =
+  {
+    "untagged", "simulation", "render", "workers", "ai", "pathfinding", "dmaps", "level init"
+  };
+  return tag < ALLOC_TAG_NUM ? names[tag] : "?";
+}
+
+alloc::TagScope::TagScope(AllocTag tag) : prev(currentTag)
+{
+  currentTag = tag;
+}
+
+alloc::TagScope::~TagScope()
+{
+  currentTag = prev;
+}
+
+alloc::ZeroAllocScope::ZeroAllocScope(const char *scope_name) : name(scope_name), prevName(zeroAllocName)
+{
+  zeroAllocName = scope_name;
+}
+
+alloc::ZeroAllocScope::~ZeroAllocScope()
+{
+  zeroAllocName = prevName;
+}
+
+void alloc::end_frame()
+{
+  for (int tag = 0; tag < ALLOC_TAG_NUM; ++tag)
+  {
+    lastFrame[tag].count = counts[tag].exchange(0, std::memory_order_relaxed);
+    lastFrame[tag].bytes = bytes[tag].exchange(0, std::memory_order_relaxed);
+  }
+}
+
+alloc::TagStats alloc::last_frame(AllocTag tag)
+{
+  return lastFrame[tag];
+}
+
+uint64_t alloc::zero_alloc_violations()
+{
+  return violations.load(std::memory_order_relaxed);
+}
+
+void alloc::handle_keys()
+{
+  if (IsKeyPressed(KEY_F5))
+    overlayEnabled = !overlayEnabled;
+}
+
+void alloc::draw_overlay(int x, int y)
+{
+  if (!overlayEnabled)
+    return;
+  constexpr int fontSize = 16;
+  DrawRectangle(x - 4, y - 4, 420, (ALLOC_TAG_NUM + 2) * (fontSize + 2) + 8, Fade(BLACK, 0.7f));
+  DrawText(TextFormat("%-12s %8s %10s", "tag", "allocs", "bytes"), x, y, fontSize, YELLOW);
+  for (int tag = 0; tag < ALLOC_TAG_NUM; ++tag)
+    DrawText(TextFormat("%-12s %8llu %10llu", tag_name(AllocTag(tag)),
+                        (unsigned long long)lastFrame[tag].count, (unsigned long long)lastFrame[tag].bytes),
+             x, y + (tag + 1) * (fontSize + 2), fontSize, WHITE);
+  DrawText(TextFormat("zero-alloc violations: %llu", (unsigned long long)zero_alloc_violations()),
+           x, y + (ALLOC_TAG_NUM + 1) * (fontSize + 2), fontSize, violations ? RED : WHITE);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Counts heap allocations per subsystem. Global operator new is replaced in allocTracker.cpp,
+// every allocation is charged to the tag of the innermost ALLOC_TAG_SCOPE on the calling thread.
+// ZERO_ALLOC_SCOPE marks code that must not allocate: debug builds abort on the first
+// allocation inside it, release builds count it as a violation.
+enum AllocTag : uint8_t
+{
+  ALLOC_UNTAGGED = 0,
+  ALLOC_SIMULATION, // systems in the fixed step pipeline not covered by a narrower tag
+  ALLOC_RENDER,
+  ALLOC_WORKERS,    // systems run on flecs worker threads
+  ALLOC_AI,         // behaviour trees and world info gathering
+  ALLOC_PATHFINDING,
+  ALLOC_DMAPS,
+  ALLOC_LEVEL_INIT,
+  ALLOC_TAG_NUM
+};
+
+namespace alloc
+{
+  struct TagStats
+  {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+  };
+
+  AllocTag current_tag();
+  const char *tag_name(AllocTag tag);
+
+  struct TagScope
+  {
+    AllocTag prev;
+    explicit TagScope(AllocTag tag);
+    ~TagScope();
+  };
+
+  struct ZeroAllocScope
+  {
+    const char *name;
+    const char *prevName;
+    ZeroAllocScope(const char *scope_name);
+    ~ZeroAllocScope();
+  };
+
+  // moves the counters gathered since the previous call into the last frame stats
+  void end_frame();
+  TagStats last_frame(AllocTag tag);
+  uint64_t zero_alloc_violations();
+
+  // F5 toggles it
+  void handle_keys();
+  void draw_overlay(int x, int y);
+}
+
+#define ALLOC_CONCAT_IMPL(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_IMPL(a, b)
+#define ALLOC_TAG_SCOPE(tag) const alloc::TagScope ALLOC_CONCAT(allocTag, __LINE__)(tag)
+#define ZERO_ALLOC_SCOPE(name) const alloc::ZeroAllocScope ALLOC_CONCAT(zeroAlloc, __LINE__)(name)
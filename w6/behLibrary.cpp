@@ -4,7 +4,9 @@
 #include "math.h"
 #include "raylib.h"
 #include "blackboard.h"
+#include "gameRandom.h"
 #include "steering.h"
+#include "frameArena.h"
 #include <algorithm>
 
 struct CompoundNode : public BehNode
@@ -23,6 +25,12 @@ struct CompoundNode : public BehNode
     nodes.push_back(node);
     return *this;
   }
+
+  void reset() override
+  {
+    for (BehNode *node : nodes)
+      node->reset();
+  }
 };
 
 struct Sequence : public CompoundNode
@@ -63,9 +71,15 @@ struct UtilitySelector : public BehNode
       delete node.first;
   }
 
+  void reset() override
+  {
+    for (auto& node : utilityNodes)
+      node.first->reset();
+  }
+
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
-    std::vector<std::pair<float, size_t>> utilityScores;
+    frame_vector<std::pair<float, size_t>> utilityScores;
     for (size_t i = 0; i < utilityNodes.size(); ++i)
     {
       const float utilityScore = utilityNodes[i].second(bb);
@@ -102,11 +116,7 @@ struct MoveToEntity : public BehNode
     {
       return BEH_FAIL;
     }
-    if (entity.has<Fleer>())
-    {
-      entity.remove<Fleer>();
-    }
-    entity.add<Seeker>();
+    steer::set_steer_mode(entity, SteerSeek);
     return res;
   }
 };
@@ -182,11 +192,7 @@ struct Flee : public BehNode
     {
       return BEH_FAIL;
     }
-    if (entity.has<Seeker>())
-    {
-      entity.remove<Seeker>();
-    }
-    entity.add<Fleer>();
+    steer::set_steer_mode(entity, SteerFlee);
     return res;
   }
 };
@@ -214,7 +220,7 @@ struct Patrol : public BehNode
       if (dist(pos, patrolPos) > patrolDist)
         a.action = move_towards(pos, patrolPos);
       else
-        a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
+        a.action = game_random(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
     });
     return res;
   }
@@ -15,6 +15,8 @@ struct BehNode
 {
   virtual ~BehNode() {}
   virtual BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) = 0;
+  // drops state kept between updates, nodes that keep none don't override it
+  virtual void reset() {}
 };
 
 struct BehaviourTree
@@ -36,5 +38,11 @@ struct BehaviourTree
   {
     root->update(ecs, entity, bb);
   }
+
+  void reset()
+  {
+    if (root)
+      root->reset();
+  }
 };
 
@@ -31,6 +31,13 @@ public:
   {
     return data[idx];
   }
+
+  // values go back to defaults, registered names keep their indices
+  void reset_values()
+  {
+    for (DataType &v : data)
+      v = DataType();
+  }
 private:
   std::unordered_map<std::string, size_t> nameIndices;
   std::vector<DataType> data;
@@ -60,6 +67,15 @@ public:
     return NamedDataPool<DataType>::get(idx);
   }
 
+  // for a pooled entity starting a new life, indices cached by its behaviour nodes stay valid
+  void reset()
+  {
+    NamedDataPool<float>::reset_values();
+    NamedDataPool<int>::reset_values();
+    NamedDataPool<flecs::entity>::reset_values();
+    NamedDataPool<Position>::reset_values();
+  }
+
   // not perf optimized
   template<typename DataType>
   DataType get(const char *name)
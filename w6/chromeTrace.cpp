@@ -0,0 +1,167 @@
+#include "chromeTrace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+  struct Event
+  {
+    const char *name;
+    const char *argName;
+    int64_t arg;
+    double ts; // us since session start
+    double dur; // negative for instant events
+  };
+
+  struct ThreadBuffer
+  {
+    uint32_t tid = 0;
+    const char *name = nullptr;
+    std::vector<Event> events;
+  };
+
+  // keeps a runaway session from eating all memory
+  constexpr size_t max_events_per_thread = 1 << 20;
+
+  std::mutex buffersMutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  // Buffers of threads that exited. flecs recreates its workers on every ecs.reset(), a new
+  // thread takes over one of these with its tid and the events recorded so far, so the worker
+  // tracks continue across levels instead of piling up.
+  std::vector<ThreadBuffer*> freeBuffers;
+
+  struct ThreadBufferOwner
+  {
+    ThreadBuffer *buffer = nullptr;
+
+    ~ThreadBufferOwner()
+    {
+      if (!buffer)
+        return;
+      std::lock_guard<std::mutex> lock(buffersMutex);
+      freeBuffers.push_back(buffer);
+    }
+  };
+  std::atomic<uint32_t> nextTid = 0;
+  std::atomic<bool> active = false;
+  std::chrono::steady_clock::time_point sessionStart;
+  FILE *out = nullptr;
+
+  ThreadBuffer &thread_buffer()
+  {
+    static thread_local ThreadBufferOwner owner;
+    if (!owner.buffer)
+    {
+      std::lock_guard<std::mutex> lock(buffersMutex);
+      if (!freeBuffers.empty())
+      {
+        owner.buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        owner.buffer->name = nullptr;
+      }
+      else
+      {
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        owner.buffer = buffers.back().get();
+        owner.buffer->tid = nextTid.fetch_add(1);
+      }
+    }
+    return *owner.buffer;
+  }
+
+  double now_us()
+  {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sessionStart).count();
+  }
+
+  void push(const Event &e)
+  {
+    ThreadBuffer &buf = thread_buffer();
+    if (buf.events.size() < max_events_per_thread)
+      buf.events.push_back(e);
+  }
+}
+
+void trace::begin_session(const char *path)
+{
+  out = fopen(path, "w");
+  if (!out)
+    return;
+  sessionStart = std::chrono::steady_clock::now();
+  set_thread_name("main");
+  active.store(true, std::memory_order_release);
+}
+
+void trace::end_session()
+{
+  if (!active.exchange(false))
+    return;
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  fprintf(out, "{\"traceEvents\":[\n");
+  bool first = true;
+  auto separator = [&]() { fprintf(out, first ? "" : ",\n"); first = false; };
+  for (const std::unique_ptr<ThreadBuffer> &buf : buffers)
+  {
+    separator();
+    if (buf->name)
+      fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+              buf->tid, buf->name);
+    else
+      fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}",
+              buf->tid, buf->tid);
+    for (const Event &e : buf->events)
+    {
+      separator();
+      if (e.dur < 0.0)
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                e.name, buf->tid, e.ts);
+      else if (e.argName)
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%lld}}",
+                e.name, buf->tid, e.ts, e.dur, e.argName, (long long)e.arg);
+      else
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                e.name, buf->tid, e.ts, e.dur);
+    }
+    buf->events.clear();
+  }
+  fprintf(out, "\n]}\n");
+  fclose(out);
+  out = nullptr;
+}
+
+bool trace::is_active()
+{
+  return active.load(std::memory_order_acquire);
+}
+
+uint32_t trace::thread_id()
+{
+  return thread_buffer().tid;
+}
+
+void trace::set_thread_name(const char *name)
+{
+  thread_buffer().name = name;
+}
+
+trace::Scope::Scope(const char *cat_name, const char *arg_name, int64_t arg_value)
+  : name(cat_name), argName(arg_name), arg(arg_value), start(is_active() ? now_us() : -1.0)
+{
+}
+
+trace::Scope::~Scope()
+{
+  if (start < 0.0 || !is_active())
+    return;
+  push(Event{name, argName, arg, start, now_us() - start});
+}
+
+void trace::instant(const char *name)
+{
+  if (is_active())
+    push(Event{name, nullptr, 0, now_us(), -1.0});
+}
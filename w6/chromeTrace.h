@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+// Timeline events in Chrome trace_event JSON, for chrome://tracing or Perfetto. Events are
+// buffered per thread and written when the session ends. The macros compile to nothing unless
+// the ENABLE_TRACING cmake option is on, the functions stay available either way.
+namespace trace
+{
+  void begin_session(const char *path);
+  // writes buffered events of all threads, call once the worker threads are idle
+  void end_session();
+  bool is_active();
+
+  // small sequential id of the calling thread, shown as tid
+  uint32_t thread_id();
+  // name string must outlive the session, a literal in practice
+  void set_thread_name(const char *name);
+
+  struct Scope
+  {
+    const char *name;
+    const char *argName;
+    int64_t arg;
+    double start;
+
+    Scope(const char *cat_name, const char *arg_name = nullptr, int64_t arg_value = 0);
+    ~Scope();
+  };
+
+  void instant(const char *name);
+}
+
+#if defined(ENABLE_TRACING)
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) const trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg_name, arg_value) \
+  const trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name, arg_name, int64_t(arg_value))
+#define TRACE_INSTANT(name) trace::instant(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_ARG(name, arg_name, arg_value) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#endif
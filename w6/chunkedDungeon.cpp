@@ -0,0 +1,68 @@
+#include "chunkedDungeon.h"
+#include <algorithm>
+#include <cstring>
+#include "dungeonGen.h"
+#include "chromeTrace.h"
+
+static uint64_t chunk_key(int cx, int cy)
+{
+  return (uint64_t(uint32_t(cy)) << 32) | uint32_t(cx);
+}
+
+const ChunkedDungeon::Chunk &ChunkedDungeon::page_in(int cx, int cy)
+{
+  auto [it, inserted] = chunks.try_emplace(chunk_key(cx, cy));
+  Chunk &chunk = it->second;
+  if (inserted)
+  {
+    TRACE_SCOPE("chunk_gen");
+    chunk.tiles.resize(chunk_size * chunk_size);
+    gen_drunk_chunk(chunk.tiles.data(), chunk_size, cx, cy, chunksX, chunksY, seed);
+  }
+  chunk.lastUsed = ++useCounter;
+  return chunk;
+}
+
+void ChunkedDungeon::evict()
+{
+  if (chunks.size() <= maxResident)
+    return;
+  std::vector<std::pair<uint64_t, uint64_t>> byUse; // last use, key
+  byUse.reserve(chunks.size());
+  for (const auto &[key, chunk] : chunks)
+    byUse.emplace_back(chunk.lastUsed, key);
+  const size_t dropCount = chunks.size() - maxResident;
+  std::nth_element(byUse.begin(), byUse.begin() + dropCount, byUse.end());
+  for (size_t i = 0; i < dropCount; ++i)
+    chunks.erase(byUse[i].second);
+}
+
+ChunkedDungeon make_chunked_dungeon(size_t w, size_t h, unsigned seed)
+{
+  ChunkedDungeon store;
+  store.seed = seed;
+  store.chunksX = int((w + ChunkedDungeon::chunk_size - 1) / ChunkedDungeon::chunk_size);
+  store.chunksY = int((h + ChunkedDungeon::chunk_size - 1) / ChunkedDungeon::chunk_size);
+  return store;
+}
+
+DungeonData extract_chunks(ChunkedDungeon &store, int min_cx, int min_cy, int max_cx, int max_cy)
+{
+  constexpr size_t cs = ChunkedDungeon::chunk_size;
+  DungeonData dd;
+  dd.width = size_t(max_cx - min_cx + 1) * cs;
+  dd.height = size_t(max_cy - min_cy + 1) * cs;
+  dd.originX = min_cx * int(cs);
+  dd.originY = min_cy * int(cs);
+  dd.tiles.resize(dd.width * dd.height);
+  for (int cy = min_cy; cy <= max_cy; ++cy)
+    for (int cx = min_cx; cx <= max_cx; ++cx)
+    {
+      const ChunkedDungeon::Chunk &chunk = store.page_in(cx, cy);
+      const size_t x0 = size_t(cx - min_cx) * cs;
+      const size_t y0 = size_t(cy - min_cy) * cs;
+      for (size_t y = 0; y < cs; ++y)
+        memcpy(&dd.tiles[(y0 + y) * dd.width + x0], &chunk.tiles[y * cs], cs);
+    }
+  return dd;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "ecsTypes.h"
+
+// Tiles of a level split into chunk_size x chunk_size chunks. A chunk is generated from the level
+// seed on first access and dropped again by evict() once it hasn't been used for a while, it comes
+// back identical the next time it's needed. The level is never whole in memory, so its size is only
+// limited by the chunk coordinates. Not synchronised, one thread at a time owns a store.
+struct ChunkedDungeon
+{
+  static constexpr size_t chunk_size = 64;
+
+  struct Chunk
+  {
+    std::vector<char> tiles; // chunk_size * chunk_size
+    uint64_t lastUsed = 0;
+  };
+
+  unsigned seed = 0;
+  int chunksX = 0;
+  int chunksY = 0;
+  size_t maxResident = 32; // chunks kept after evict(), at least a whole window
+
+  std::unordered_map<uint64_t, Chunk> chunks;
+  uint64_t useCounter = 0;
+
+  size_t width() const { return size_t(chunksX) * chunk_size; }
+  size_t height() const { return size_t(chunksY) * chunk_size; }
+
+  const Chunk &page_in(int cx, int cy);
+  // drops least recently used chunks above maxResident
+  void evict();
+  size_t resident_bytes() const { return chunks.size() * chunk_size * chunk_size; }
+};
+
+// w x h tiles rounded up to whole chunks
+ChunkedDungeon make_chunked_dungeon(size_t w, size_t h, unsigned seed);
+
+// copies chunks [min_cx, max_cx] x [min_cy, max_cy] into a dungeon window, paging them in as needed
+DungeonData extract_chunks(ChunkedDungeon &store, int min_cx, int min_cy, int max_cx, int max_cy);
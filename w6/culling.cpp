@@ -0,0 +1,63 @@
+#include "culling.h"
+#include <algorithm>
+#include "spatialGrid.h"
+#include "worldRegistry.h"
+
+ViewRect camera_view_rect(const Camera2D &cam, float margin)
+{
+  const float w = float(GetScreenWidth());
+  const float h = float(GetScreenHeight());
+  // all four corners so a rotated camera is covered as well
+  const Vector2 corners[4] =
+  {
+    GetScreenToWorld2D(Vector2{0.f, 0.f}, cam),
+    GetScreenToWorld2D(Vector2{w, 0.f}, cam),
+    GetScreenToWorld2D(Vector2{0.f, h}, cam),
+    GetScreenToWorld2D(Vector2{w, h}, cam)
+  };
+  ViewRect view{{corners[0].x, corners[0].y}, {corners[0].x, corners[0].y}};
+  for (const Vector2 &c : corners)
+  {
+    view.min = Position{std::min(view.min.x, c.x), std::min(view.min.y, c.y)};
+    view.max = Position{std::max(view.max.x, c.x), std::max(view.max.y, c.y)};
+  }
+  view.min = view.min - Position{margin, margin};
+  view.max = view.max + Position{margin, margin};
+  return view;
+}
+
+void register_culling(flecs::world &ecs, float margin)
+{
+  ecs.set<ViewRect>({});
+  ecs.set<VisibleSet>({});
+  ecs.set<CullStats>({});
+  ecs.system<CullStats>()
+    .kind(flecs::OnStore)
+    .each([&ecs, margin](CullStats &stats)
+    {
+      ViewRect &view = *ecs.get_mut<ViewRect>();
+      VisibleSet &visible = *ecs.get_mut<VisibleSet>();
+      registry(ecs).cameras.each([&](Camera2D &cam) { view = camera_view_rect(cam, margin); });
+      stats = CullStats{};
+      visible.entities.clear();
+      const SpatialGrid *grid = ecs.get<SpatialGrid>();
+      if (!grid)
+        return;
+      grid->each_in_rect(view.min, view.max, [&](const SpatialGrid::Item &item)
+      {
+        visible.entities.push_back(item.entity);
+      });
+      stats.drawn += visible.entities.size();
+      stats.culled += grid->items.size() - visible.entities.size();
+    });
+}
+
+bool cull_test(flecs::world &ecs, const Position &lo, const Position &hi)
+{
+  const ViewRect *view = ecs.get<ViewRect>();
+  CullStats *stats = ecs.get_mut<CullStats>();
+  const bool visible = !view || view->overlaps(lo, hi);
+  if (stats)
+    (visible ? stats->drawn : stats->culled)++;
+  return visible;
+}
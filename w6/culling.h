@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <raylib.h>
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// world space box seen through the camera this frame
+struct ViewRect
+{
+  Position min;
+  Position max;
+
+  bool overlaps(const Position &lo, const Position &hi) const
+  {
+    return lo.x <= max.x && hi.x >= min.x && lo.y <= max.y && hi.y >= min.y;
+  }
+};
+
+// moving entities on screen, picked from the spatial grid before the draw systems run
+struct VisibleSet
+{
+  std::vector<flecs::entity_t> entities;
+};
+
+struct CullStats
+{
+  size_t drawn = 0;
+  size_t culled = 0;
+};
+
+// registers the render stage filling ViewRect, VisibleSet and resetting CullStats,
+// has to go before the draw systems. margin extends the view to fit sprites anchored at their corner.
+void register_culling(flecs::world &ecs, float margin);
+
+ViewRect camera_view_rect(const Camera2D &cam, float margin);
+// counts lo..hi box as drawn or culled, returns true if it should be drawn
+bool cull_test(flecs::world &ecs, const Position &lo, const Position &hi);
@@ -0,0 +1,82 @@
+#include "debugDraw.h"
+#include <algorithm>
+#include <cstring>
+#include "culling.h"
+
+static bool channelEnabled[DEBUG_CHANNEL_NUM] = {};
+static const int channelKeys[DEBUG_CHANNEL_NUM] = {KEY_F1, KEY_F2};
+
+void DebugRecorder::line(const Position &from, const Position &to, float thick, Color color)
+{
+  DebugPrimitive prim{DebugPrimitive::Line, from + offset, to + offset, thick, color, {}};
+  prims.push_back(prim);
+}
+
+void DebugRecorder::rect_lines(const Rectangle &rect, float thick, Color color)
+{
+  DebugPrimitive prim{DebugPrimitive::RectLines, Position{rect.x, rect.y} + offset,
+                      Position{rect.x + rect.width, rect.y + rect.height} + offset, thick, color, {}};
+  prims.push_back(prim);
+}
+
+void DebugRecorder::text(const char *str, const Position &pos, int size, Color color)
+{
+  DebugPrimitive prim{DebugPrimitive::Text, pos + offset, pos + offset, float(size), color, {}};
+  strncpy(prim.text, str, sizeof(prim.text) - 1);
+  const float len = float(strlen(prim.text));
+  prim.hi = prim.lo + Position{len * size, float(size)};
+  prims.push_back(prim);
+}
+
+void register_debug_draw(flecs::world &ecs)
+{
+  ecs.set<DebugDraw>({});
+  // once per frame, key presses would be seen on every fixed step otherwise
+  ecs.system<DebugDraw>()
+    .kind(flecs::OnStore)
+    .each([](DebugDraw &dd)
+    {
+      for (int ch = 0; ch < DEBUG_CHANNEL_NUM; ++ch)
+        if (IsKeyPressed(channelKeys[ch]))
+        {
+          channelEnabled[ch] = !channelEnabled[ch];
+          // drop stale primitives, the source could have changed while the channel was off
+          dd.channels[ch].recorded = false;
+          dd.channels[ch].prims.clear();
+        }
+    });
+}
+
+bool debug_channel_enabled(DebugChannel ch)
+{
+  return channelEnabled[ch];
+}
+
+uint64_t debug_key_combine(uint64_t key, uint64_t v)
+{
+  key ^= v + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+  return key;
+}
+
+void debug_replay(flecs::world &ecs, const DebugDraw::Channel &channel)
+{
+  for (const DebugPrimitive &prim : channel.prims)
+  {
+    const Position lo{std::min(prim.lo.x, prim.hi.x), std::min(prim.lo.y, prim.hi.y)};
+    const Position hi{std::max(prim.lo.x, prim.hi.x), std::max(prim.lo.y, prim.hi.y)};
+    if (!cull_test(ecs, lo, hi))
+      continue;
+    switch (prim.kind)
+    {
+      case DebugPrimitive::Line:
+        DrawLineEx(Vector2{prim.lo.x, prim.lo.y}, Vector2{prim.hi.x, prim.hi.y}, prim.thick, prim.color);
+        break;
+      case DebugPrimitive::RectLines:
+        DrawRectangleLinesEx(Rectangle{lo.x, lo.y, hi.x - lo.x, hi.y - lo.y}, prim.thick, prim.color);
+        break;
+      case DebugPrimitive::Text:
+        DrawText(prim.text, int(prim.lo.x), int(prim.lo.y), int(prim.thick), prim.color);
+        break;
+    }
+  }
+}
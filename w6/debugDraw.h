@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <raylib.h>
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// overlays toggled at runtime, each one is recorded once and replayed until its source key changes
+enum DebugChannel
+{
+  DEBUG_PORTALS,   // portal grid and connections of the hovered portal, F1
+  DEBUG_EXIT_PATH, // approximated path from the player to the exit, F2
+  DEBUG_CHANNEL_NUM
+};
+
+struct DebugPrimitive
+{
+  enum Kind { Line, RectLines, Text };
+  Kind kind;
+  Position lo; // line start, rect corner or text origin
+  Position hi; // line end or opposite rect corner, text box is estimated
+  float thick; // line thickness or font size
+  Color color;
+  char text[16];
+};
+
+struct DebugRecorder
+{
+  std::vector<DebugPrimitive> &prims;
+  Position offset{0.f, 0.f}; // added to everything recorded
+
+  void line(const Position &from, const Position &to, float thick, Color color);
+  void rect_lines(const Rectangle &rect, float thick, Color color);
+  void text(const char *str, const Position &pos, int size, Color color);
+};
+
+struct DebugDraw
+{
+  struct Channel
+  {
+    bool recorded = false;
+    uint64_t sourceKey = 0;
+    std::vector<DebugPrimitive> prims;
+  };
+  Channel channels[DEBUG_CHANNEL_NUM];
+};
+
+// DebugDraw singleton and the F-key toggles, toggles outlive ecs.reset() on level up
+void register_debug_draw(flecs::world &ecs);
+
+// producers check it before doing any work of their own
+bool debug_channel_enabled(DebugChannel ch);
+
+uint64_t debug_key_combine(uint64_t key, uint64_t v);
+
+// draws recorded primitives that pass cull_test
+void debug_replay(flecs::world &ecs, const DebugDraw::Channel &channel);
+
+// replays the channel, calls produce(DebugRecorder&) first if nothing was recorded for source_key
+template<typename Producer>
+void debug_draw(flecs::world &ecs, DebugChannel ch, uint64_t source_key, Producer produce)
+{
+  if (!debug_channel_enabled(ch))
+    return;
+  DebugDraw::Channel &channel = ecs.get_mut<DebugDraw>()->channels[ch];
+  if (!channel.recorded || channel.sourceKey != source_key)
+  {
+    channel.prims.clear();
+    DebugRecorder rec{channel.prims};
+    produce(rec);
+    channel.recorded = true;
+    channel.sourceKey = source_key;
+  }
+  debug_replay(ecs, channel);
+}
@@ -1,22 +1,10 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
-
-template<typename Callable>
-static void query_dungeon_data(flecs::world &ecs, Callable c)
-{
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
-
-  dungeonDataQuery.each(c);
-}
-
-template<typename Callable>
-static void query_characters_positions(flecs::world &ecs, Callable c)
-{
-  static auto characterPositionQuery = ecs.query<const Position, const Team>();
-
-  characterPositionQuery.each(c);
-}
+#include "profiler.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include <algorithm>
 
 constexpr float invalid_tile_value = 1e5f;
 
@@ -33,7 +21,7 @@ static void process_dmap(std::vector<float> &map, const DungeonData &dd)
   bool done = false;
   auto getMapAt = [&](size_t x, size_t y, float def)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
+    if (x < dd.width && y < dd.height && dd.tiles[y * dd.width + x] == dungeon::floor)
       return map[y * dd.width + x];
     return def;
   };
@@ -66,67 +54,79 @@ static void process_dmap(std::vector<float> &map, const DungeonData &dd)
   }
 }
 
-static std::pair<int, int> get_pos(const Position pos)
+IntPos dmaps::source_tile(const Position &pos)
 {
   Position foot_pos = pos + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
-  return {foot_pos.x / dungeon::tile_size, foot_pos.y / dungeon::tile_size};
+  return IntPos{int(foot_pos.x / dungeon::tile_size), int(foot_pos.y / dungeon::tile_size)};
 }
 
-void dmaps::gen_multiobject_approach_map(flecs::world &ecs, const std::vector<Position>& obj_pos, std::vector<float> &map)
+// window index of the tile under the feet of pos, false when it's outside the streamed in window
+static bool get_tile(const DungeonData &dd, const Position pos, size_t &idx)
 {
-  ecs.each([&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    for (auto pos : obj_pos)
-    {
-      auto [x, y] = get_pos(pos);
-      map[y * dd.width + x] = 0.f;
-    }
-    process_dmap(map, dd);
-  });
+  const IntPos tile = dmaps::source_tile(pos);
+  const int x = tile.x - dd.originX;
+  const int y = tile.y - dd.originY;
+  if (x < 0 || y < 0 || size_t(x) >= dd.width || size_t(y) >= dd.height)
+    return false;
+  idx = size_t(y) * dd.width + size_t(x);
+  return true;
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_multiobject_approach_map(const DungeonData &dd, const std::vector<Position>& obj_pos, std::vector<float> &map)
 {
-  ecs.each([&](const DungeonData &dd)
+  PROFILE_SCOPE("dmaps::gen_multiobject_approach_map");
+  TRACE_SCOPE("dmap_multiobject_approach");
+  ALLOC_TAG_SCOPE(ALLOC_DMAPS);
+  init_tiles(map, dd);
+  for (auto pos : obj_pos)
   {
-    init_tiles(map, dd);
-    ecs.each([&](const Position &pos, const Team &t)
-    {
-      if (t.team == 0) // player team hardcode
-      {
-        auto [x, y] = get_pos(pos);
-        map[y * dd.width + x] = 0.f;
-      }
-    });
-    process_dmap(map, dd);
-  });
+    size_t idx;
+    if (get_tile(dd, pos, idx))
+      map[idx] = 0.f;
+  }
+  process_dmap(map, dd);
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_player_flee_map(const DungeonData &dd, const std::vector<float> &approach_map, std::vector<float> &map)
 {
-  gen_player_approach_map(ecs, map);
+  PROFILE_SCOPE("dmaps::gen_player_flee_map");
+  TRACE_SCOPE("dmap_player_flee");
+  ALLOC_TAG_SCOPE(ALLOC_DMAPS);
+  map = approach_map;
   for (float &v : map)
     if (v < invalid_tile_value)
       v *= -1.2f;
-  ecs.each([&](const DungeonData &dd)
-  {
-    process_dmap(map, dd);
-  });
+  process_dmap(map, dd);
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_flow_field(const DungeonData &dd, const std::vector<float> &map, FlowFieldData &flow)
 {
-  static auto hiveQuery = ecs.query<const Position, const Hive>();
-  ecs.each([&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    /*hiveQuery*/ecs.each([&](const Position &pos, const Hive &)
+  PROFILE_SCOPE("dmaps::gen_flow_field");
+  TRACE_SCOPE("dmap_flow_field");
+  ALLOC_TAG_SCOPE(ALLOC_DMAPS);
+  flow.width = dd.width;
+  flow.height = dd.height;
+  flow.originX = dd.originX;
+  flow.originY = dd.originY;
+  flow.dirs.assign(dd.width * dd.height, EA_NOP);
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
     {
-      auto [x, y] = get_pos(pos);
-      map[y * dd.width + x] = 0.f;
-    });
-    process_dmap(map, dd);
-  });
+      float minWt = map[y * dd.width + x];
+      uint8_t dir = EA_NOP;
+      auto try_move = [&](bool inside, size_t nx, size_t ny, Actions a)
+      {
+        if (inside && map[ny * dd.width + nx] < minWt)
+        {
+          minWt = map[ny * dd.width + nx];
+          dir = uint8_t(a);
+        }
+      };
+      // same order as EA_MOVE_* so ties resolve like the per-agent search did
+      try_move(x > 0, x - 1, y, EA_MOVE_LEFT);
+      try_move(x + 1 < dd.width, x + 1, y, EA_MOVE_RIGHT);
+      try_move(y + 1 < dd.height, x, y + 1, EA_MOVE_DOWN);
+      try_move(y > 0, x, y - 1, EA_MOVE_UP);
+      flow.dirs[y * dd.width + x] = dir;
+    }
 }
-
@@ -1,14 +1,17 @@
 #pragma once
 #include <vector>
-#include <flecs.h>
 
 #include "ecsTypes.h"
 
 namespace dmaps
 {
-  void gen_multiobject_approach_map(flecs::world &ecs, const std::vector<Position>& obj_pos, std::vector<float> &map);
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
+  // level tile a source at pos seeds, the one under its feet
+  IntPos source_tile(const Position &pos);
+  void gen_multiobject_approach_map(const DungeonData &dd, const std::vector<Position>& obj_pos, std::vector<float> &map);
+  // flee map from an approach map that is already built, saves relaxing it again
+  void gen_player_flee_map(const DungeonData &dd, const std::vector<float> &approach_map, std::vector<float> &map);
+
+  // direction towards the lowest neighbour of every tile, so followers need a single lookup
+  void gen_flow_field(const DungeonData &dd, const std::vector<float> &map, FlowFieldData &flow);
 };
 
@@ -1,10 +1,7 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include <cstring> // memset
-#include <cstdio> // printf
 #include <random>
-#include <chrono> // std::chrono
-#include <functional> // std::bind
 #include "ecsTypes.h"
 #include "math.h"
 #include <limits>
@@ -15,73 +12,89 @@ struct IntPosition
   int y;
 };
 
-void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
+static uint64_t mix_seed(uint64_t seed, uint64_t a, uint64_t b, uint64_t c)
 {
-  //constexpr char wall = '#';
-  //constexpr char flr = ' ';
+  // splitmix64 over the inputs, neighbouring chunks get unrelated streams
+  uint64_t h = seed;
+  for (uint64_t v : {a, b, c})
+  {
+    h += 0x9e3779b97f4a7c15ull + v;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    h ^= h >> 31;
+  }
+  return h;
+}
 
-  memset(tiles, dungeon::wall, w * h);
+static void dig_line(char *tiles, size_t size, IntPosition from, const IntPosition &to)
+{
+  IntPosition pos = from;
+  tiles[size_t(pos.y) * size + size_t(pos.x)] = dungeon::floor;
+  while (dist_sq(pos, to) > 0.f)
+  {
+    const IntPosition delta = {to.x - pos.x, to.y - pos.y};
+    if (abs(delta.x) > abs(delta.y))
+      pos.x += delta.x > 0 ? 1 : -1;
+    else
+      pos.y += delta.y > 0 ? 1 : -1;
+    tiles[size_t(pos.y) * size + size_t(pos.x)] = dungeon::floor;
+  }
+}
 
-  // generator
-  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
-  std::default_random_engine seedGenerator(seed);
-  std::default_random_engine widthGenerator(seedGenerator());
-  std::default_random_engine heightGenerator(seedGenerator());
-  std::default_random_engine dirGenerator(seedGenerator());
+void gen_drunk_chunk(char *tiles, size_t size, int cx, int cy, int chunks_x, int chunks_y, unsigned seed)
+{
+  memset(tiles, dungeon::wall, size * size);
 
-  // distributions
-  std::uniform_int_distribution<size_t> widthDist(1, w-2);
-  std::uniform_int_distribution<size_t> heightDist(1, h-2);
-  std::uniform_int_distribution<size_t> dirDist(0, 3);
-  auto rndWd = std::bind(widthDist, widthGenerator);
-  auto rndHt = std::bind(heightDist, heightGenerator);
-  auto rndDir = std::bind(dirDist, dirGenerator);
+  std::default_random_engine gen(mix_seed(seed, uint64_t(cx), uint64_t(cy), 0));
+  // the outer border of the level stays solid, inner chunk borders may be dug through
+  const int minX = cx == 0 ? 1 : 0;
+  const int minY = cy == 0 ? 1 : 0;
+  const int maxX = cx == chunks_x - 1 ? int(size) - 2 : int(size) - 1;
+  const int maxY = cy == chunks_y - 1 ? int(size) - 2 : int(size) - 1;
+  std::uniform_int_distribution<int> xDist(minX, maxX);
+  std::uniform_int_distribution<int> yDist(minY, maxY);
+  std::uniform_int_distribution<int> dirDist(0, 3);
 
   const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
 
   constexpr size_t numIter = 4;
-  constexpr size_t maxExcavations = 200;
+  constexpr size_t maxExcavations = 300;
   std::vector<IntPosition> startPos;
   for (size_t iter = 0; iter < numIter; ++iter)
   {
-    // select random point on map
-    size_t x = rndWd();
-    size_t y = rndHt();
-    startPos.push_back({int(x), int(y)});
+    int x = xDist(gen);
+    int y = yDist(gen);
+    startPos.push_back({x, y});
     size_t numExcavations = 0;
     while (numExcavations < maxExcavations)
     {
-      if (tiles[y * w + x] == dungeon::wall)
+      if (tiles[size_t(y) * size + size_t(x)] == dungeon::wall)
       {
         numExcavations++;
-        tiles[y * w + x] = dungeon::floor;
+        tiles[size_t(y) * size + size_t(x)] = dungeon::floor;
       }
-      // choose random dir
-      size_t dir = rndDir(); // 0 - right, 1 - up, 2 - left, 3 - down
-      int newX = std::min(std::max(int(x) + dirs[dir][0], 1), int(w) - 2);
-      int newY = std::min(std::max(int(y) + dirs[dir][1], 1), int(h) - 2);
-      x = size_t(newX);
-      y = size_t(newY);
+      const int dir = dirDist(gen);
+      x = std::min(std::max(x + dirs[dir][0], minX), maxX);
+      y = std::min(std::max(y + dirs[dir][1], minY), maxY);
     }
   }
 
-  // construct a path from start pos to all other start poses
-  for (const IntPosition &spos : startPos)
-    for (const IntPosition &epos : startPos)
-    {
-      IntPosition pos = spos;
-      while (dist_sq(pos, epos) > 0.f)
-      {
-        const IntPosition delta = {epos.x - pos.x, epos.y - pos.y};
-        if (abs(delta.x) > abs(delta.y))
-          pos.x += delta.x > 0 ? 1 : -1;
-        else
-          pos.y += delta.y > 0 ? 1 : -1;
-        tiles[size_t(pos.y) * w + size_t(pos.x)] = dungeon::floor;
-      }
-    }
+  // a door's offset along a border comes from the border alone, both chunks dig the same one
+  auto door = [&](int bx, int by, uint64_t axis)
+  {
+    return int(mix_seed(seed, uint64_t(bx), uint64_t(by), axis) % (size - 4)) + 2;
+  };
+  const int last = int(size) - 1;
+  if (cx > 0)
+    startPos.push_back({0, door(cx - 1, cy, 1)});
+  if (cx + 1 < chunks_x)
+    startPos.push_back({last, door(cx, cy, 1)});
+  if (cy > 0)
+    startPos.push_back({door(cx, cy - 1, 2), 0});
+  if (cy + 1 < chunks_y)
+    startPos.push_back({door(cx, cy, 2), last});
 
-  for (size_t y = 0; y < h; ++y)
-    printf("%.*s\n", int(w), tiles + y * w);
+  // walks and doors all lead to the first walk
+  for (size_t i = 1; i < startPos.size(); ++i)
+    dig_line(tiles, size, startPos[i], startPos[0]);
 }
-
@@ -1,4 +1,7 @@
 #pragma once
 #include <cstddef> // size_t
 
-void gen_drunk_dungeon(char *tiles, size_t w, size_t h);
+// One chunk of a level that's generated chunk by chunk, the result only depends on the seed and the
+// chunk coordinates. Neighbouring chunks agree on a door in their shared border and every floor
+// tile of a chunk is connected to its doors, so the level is connected without ever being whole.
+void gen_drunk_chunk(char *tiles, size_t size, int cx, int cy, int chunks_x, int chunks_y, unsigned seed);
@@ -1,5 +1,21 @@
 #include "dungeonUtils.h"
 #include "raylib.h"
+#include "gameRandom.h"
+#include "worldRegistry.h"
+
+template<typename Random>
+static Position pick_walkable_tile(const DungeonData &dd, Random rnd)
+{
+  // prebuild all walkable and get one of them
+  std::vector<Position> posList;
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] == dungeon::floor)
+        posList.push_back(Position{(dd.originX + x + 0.01f) * dungeon::tile_size,
+                                   (dd.originY + y + 0.01f) * dungeon::tile_size});
+  size_t rndIdx = size_t(rnd(0, int(posList.size()) - 1));
+  return posList[rndIdx];
+}
 
 Position dungeon::find_walkable_tile(flecs::world &ecs)
 {
@@ -8,33 +24,39 @@ Position dungeon::find_walkable_tile(flecs::world &ecs)
   Position res{0, 0};
   /*dungeonDataQuery*/ecs.each([&](const DungeonData &dd)
   {
-    // prebuild all walkable and get one of them
-    std::vector<Position> posList;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{(x + 0.01f) * dungeon::tile_size, (y + 0.01f) * dungeon::tile_size});
-    size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-    res = posList[rndIdx];
+    res = pick_walkable_tile(dd, game_random);
   });
   return res;
 }
 
-bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
+Position dungeon::find_walkable_tile(const DungeonData &dd, std::default_random_engine &rng)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
-
-  bool res = false;
-  int x = pos.x / dungeon::tile_size;
-  int y = pos.y / dungeon::tile_size;
-  /*dungeonDataQuery*/ecs.each([&](const DungeonData &dd)
+  return pick_walkable_tile(dd, [&](int min, int max)
   {
-    if (x < 0 || x >= int(dd.width) ||
-        y < 0 || y >= int(dd.height))
-      return;
-    res = dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::floor;
+    return std::uniform_int_distribution<int>(min, max)(rng);
   });
-  return res;
+}
+
+bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
+{
+  const DungeonData *dd = registry(ecs).dungeon.get<DungeonData>();
+  return dd && is_tile_walkable(*dd, pos);
+}
+
+bool dungeon::is_in_window(const DungeonData &dd, Position pos)
+{
+  const int x = int(pos.x / dungeon::tile_size) - dd.originX;
+  const int y = int(pos.y / dungeon::tile_size) - dd.originY;
+  return x >= 0 && x < int(dd.width) && y >= 0 && y < int(dd.height);
+}
+
+bool dungeon::is_tile_walkable(const DungeonData &dd, Position pos)
+{
+  if (!is_in_window(dd, pos))
+    return false;
+  int x = int(pos.x / dungeon::tile_size) - dd.originX;
+  int y = int(pos.y / dungeon::tile_size) - dd.originY;
+  return dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::floor;
 }
 
 bool dungeon::is_tile_walkable(flecs::world &ecs, IntPos pos)
@@ -1,6 +1,7 @@
 #pragma once
 #include "ecsTypes.h"
 #include <flecs.h>
+#include <random>
 
 namespace dungeon
 {
@@ -10,6 +11,10 @@ namespace dungeon
   constexpr float tile_size = 64.f;
 
   Position find_walkable_tile(flecs::world &ecs);
+  Position find_walkable_tile(const DungeonData &dd, std::default_random_engine &rng);
+  // inside the streamed in window, walls included
+  bool is_in_window(const DungeonData &dd, Position pos);
   bool is_tile_walkable(flecs::world &ecs, Position pos);
+  bool is_tile_walkable(const DungeonData &dd, Position pos);
   bool is_tile_walkable(flecs::world &ecs, IntPos pos);
 };
@@ -2,21 +2,11 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <unordered_map>
 #include <math.h>
 #include <flecs.h>
 
-template <typename... Ts>
-auto& staticQuery(flecs::world& ecs, const char* name)
-{
-  auto e = ecs.lookup(name);
-  if (e == 0)
-  {
-    e = ecs.entity(name).set(ecs.query<Ts...>());
-  }
-  return *e.get<flecs::query<Ts...>>();
-}
-
 // TODO: make a lot of seprate files
 struct Position;
 
@@ -28,6 +18,9 @@ struct Position
 
 struct Velocity : public Position {};
 
+// position before the last simulation step, used to interpolate rendering
+struct PrevPosition : public Position {};
+
 struct SteerDir : public Position {};
 
 inline Position operator-(const Position &lhs, const Position &rhs)
@@ -161,6 +154,9 @@ struct Symbol
 
 struct IsPlayer {};
 
+// disabled because it's off the streamed in dungeon window, not because it's pooled
+struct Asleep {};
+
 struct WorldInfoGatherer {};
 
 struct Team
@@ -181,13 +177,15 @@ struct ActionLog
   size_t capacity = 5;
 };
 
-struct BackgroundTile {};
-
+// Window of the level streamed in around the player, tiles are indexed in window coordinates.
+// Level tile (originX + x, originY + y) is tiles[y * width + x].
 struct DungeonData
 {
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  int originX = 0;
+  int originY = 0;
 };
 
 struct DijkstraMapData
@@ -195,6 +193,30 @@ struct DijkstraMapData
   std::vector<float> map;
 };
 
+// What the player dmaps were last built from. They are only rebuilt when a player changes tile or
+// another window is swapped in, positions is scratch kept for its capacity.
+struct PlayerDmapSources
+{
+  std::vector<Position> positions;
+  std::vector<IntPos> tiles;
+  std::vector<IntPos> builtTiles;
+  int originX = 0;
+  int originY = 0;
+  size_t width = 0;
+  size_t height = 0;
+  bool built = false;
+};
+
+// per tile Actions index leading downhill on a dmap, EA_NOP where no neighbour is lower
+struct FlowFieldData
+{
+  std::vector<uint8_t> dirs;
+  size_t width = 0;
+  size_t height = 0;
+  int originX = 0; // of the dungeon window it was built over
+  int originY = 0;
+};
+
 struct VisualiseMap {};
 
 struct DmapWeights
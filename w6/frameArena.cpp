@@ -0,0 +1,129 @@
+#include "frameArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace
+{
+  std::mutex arenasMutex;
+  std::vector<std::unique_ptr<FrameArena>> arenas;
+  // arenas of threads that exited, flecs recreates its workers on every ecs.reset()
+  std::vector<FrameArena*> freeArenas;
+  thread_local FrameArena *privateArena = nullptr;
+
+  struct ThreadArena
+  {
+    FrameArena *arena = nullptr;
+
+    ~ThreadArena()
+    {
+      if (!arena)
+        return;
+      std::lock_guard<std::mutex> lock(arenasMutex);
+      freeArenas.push_back(arena);
+    }
+  };
+}
+
+FrameArena::~FrameArena()
+{
+  for (Block &b : blocks)
+    free(b.data);
+}
+
+void *FrameArena::allocate(size_t size, size_t align)
+{
+  if (!blocks.empty())
+  {
+    Block &b = blocks.back();
+    const size_t start = (offset + align - 1) & ~(align - 1);
+    if (start + size <= b.size)
+    {
+      usedTotal += start + size - offset;
+      offset = start + size;
+      return b.data + start;
+    }
+  }
+  // malloc'd blocks are aligned for any fundamental type
+  const size_t blockSize = std::max(min_block_size, size + align);
+  uint8_t *data = static_cast<uint8_t*>(malloc(blockSize));
+  if (!data)
+    throw std::bad_alloc();
+  blocks.push_back(Block{data, blockSize});
+  offset = size;
+  usedTotal += size;
+  return data;
+}
+
+void FrameArena::reset()
+{
+  if (blocks.size() > 1)
+  {
+    const size_t total = capacity();
+    for (Block &b : blocks)
+      free(b.data);
+    blocks.clear();
+    uint8_t *data = static_cast<uint8_t*>(malloc(total));
+    if (data)
+      blocks.push_back(Block{data, total});
+  }
+  offset = 0;
+  usedTotal = 0;
+}
+
+void FrameArena::rewind(const Marker &m)
+{
+  if (blocks.size() != m.blockCount)
+    return;
+  offset = m.offset;
+  usedTotal = m.usedTotal;
+}
+
+size_t FrameArena::capacity() const
+{
+  size_t total = 0;
+  for (const Block &b : blocks)
+    total += b.size;
+  return total;
+}
+
+FrameArena &frame_arena()
+{
+  if (privateArena)
+    return *privateArena;
+  static thread_local ThreadArena owner;
+  if (!owner.arena)
+  {
+    std::lock_guard<std::mutex> lock(arenasMutex);
+    if (!freeArenas.empty())
+    {
+      owner.arena = freeArenas.back();
+      freeArenas.pop_back();
+    }
+    else
+    {
+      arenas.push_back(std::make_unique<FrameArena>());
+      owner.arena = arenas.back().get();
+    }
+  }
+  return *owner.arena;
+}
+
+void reset_frame_arenas()
+{
+  std::lock_guard<std::mutex> lock(arenasMutex);
+  for (std::unique_ptr<FrameArena> &arena : arenas)
+    arena->reset();
+}
+
+PrivateFrameArenaScope::PrivateFrameArenaScope() : prev(privateArena)
+{
+  privateArena = &arena;
+}
+
+PrivateFrameArenaScope::~PrivateFrameArenaScope()
+{
+  privateArena = prev;
+}
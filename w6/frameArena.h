@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator for temporaries that die within the frame. Every thread gets its own arena, so
+// allocating is a pointer bump without locks and freeing is a no-op. reset_frame_arenas() rewinds
+// all of them at frame end, while the worker threads are idle. Whatever lives in an arena must not
+// be kept past that point, results that outlive the frame are copied into regular containers.
+struct FrameArena
+{
+  FrameArena() = default;
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+  ~FrameArena();
+
+  void *allocate(size_t size, size_t align);
+  // blocks added during the frame are merged into one, the steady state frame needs no malloc
+  void reset();
+
+  size_t used() const { return usedTotal; }
+  size_t capacity() const;
+
+  struct Marker
+  {
+    size_t blockCount;
+    size_t offset;
+    size_t usedTotal;
+  };
+  Marker mark() const { return Marker{blocks.size(), offset, usedTotal}; }
+  // frees everything allocated since the mark, unless a new block was started in between
+  void rewind(const Marker &m);
+
+  struct Block
+  {
+    uint8_t *data;
+    size_t size;
+  };
+  static constexpr size_t min_block_size = size_t(256) << 10;
+
+  std::vector<Block> blocks;
+  size_t offset = 0; // in the last block
+  size_t usedTotal = 0;
+};
+
+FrameArena &frame_arena();
+void reset_frame_arenas();
+
+// For threads working outside the frame loop, e.g. level preloading. Within the scope the thread
+// allocates from an arena of its own that reset_frame_arenas() doesn't touch, the thread resets it
+// itself once a unit of work is done.
+struct PrivateFrameArenaScope
+{
+  FrameArena arena;
+  FrameArena *prev;
+
+  PrivateFrameArenaScope();
+  ~PrivateFrameArenaScope();
+};
+
+// rewinds the thread arena on scope exit, for loops that make many short lived temporaries
+struct FrameArenaScope
+{
+  FrameArena &arena;
+  FrameArena::Marker marker;
+
+  FrameArenaScope() : arena(frame_arena()), marker(arena.mark()) {}
+  ~FrameArenaScope() { arena.rewind(marker); }
+};
+
+template<typename T>
+struct FrameAllocator
+{
+  using value_type = T;
+
+  FrameArena *arena;
+
+  FrameAllocator() : arena(&frame_arena()) {}
+  template<typename U>
+  FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T *, size_t) {}
+
+  template<typename U>
+  bool operator==(const FrameAllocator<U> &other) const { return arena == other.arena; }
+  template<typename U>
+  bool operator!=(const FrameAllocator<U> &other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using frame_vector = std::vector<T, FrameAllocator<T>>;
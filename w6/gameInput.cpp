@@ -0,0 +1,87 @@
+#include "gameInput.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <raylib.h>
+#include "gameRandom.h"
+
+static InputScript inputScript;
+static size_t scriptEntry = 0;
+static int scriptStep = 0;
+
+bool game_key_down(int key)
+{
+#ifdef HEADLESS
+  if (scriptEntry >= inputScript.entries.size())
+    return false;
+  const std::vector<int> &keys = inputScript.entries[scriptEntry].keys;
+  return std::find(keys.begin(), keys.end(), key) != keys.end();
+#else
+  return IsKeyDown(key);
+#endif
+}
+
+bool load_input_script(const std::string &path, InputScript &script)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  script.entries.clear();
+  std::string line;
+  while (std::getline(in, line))
+  {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    InputScript::Entry entry;
+    if (!(words >> entry.steps))
+      continue;
+    std::string word;
+    while (words >> word)
+    {
+      if (word == "LEFT")
+        entry.keys.push_back(KEY_LEFT);
+      else if (word == "RIGHT")
+        entry.keys.push_back(KEY_RIGHT);
+      else if (word == "UP")
+        entry.keys.push_back(KEY_UP);
+      else if (word == "DOWN")
+        entry.keys.push_back(KEY_DOWN);
+    }
+    script.entries.push_back(entry);
+  }
+  return true;
+}
+
+InputScript make_random_input_script(int entries, int min_steps, int max_steps)
+{
+  const int dirKeys[4] = {KEY_LEFT, KEY_RIGHT, KEY_UP, KEY_DOWN};
+  InputScript script;
+  for (int i = 0; i < entries; ++i)
+  {
+    InputScript::Entry entry;
+    entry.steps = game_random(min_steps, max_steps);
+    entry.keys.push_back(dirKeys[game_random(0, 3)]);
+    if (game_random(0, 1))
+      entry.keys.push_back(dirKeys[game_random(0, 3)]);
+    script.entries.push_back(entry);
+  }
+  return script;
+}
+
+void set_input_script(const InputScript &script)
+{
+  inputScript = script;
+  scriptEntry = 0;
+  scriptStep = 0;
+}
+
+void advance_input_script()
+{
+  if (scriptEntry >= inputScript.entries.size())
+    return;
+  if (++scriptStep < inputScript.entries[scriptEntry].steps)
+    return;
+  scriptStep = 0;
+  if (++scriptEntry == inputScript.entries.size() && inputScript.loop)
+    scriptEntry = 0;
+}
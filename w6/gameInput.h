@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// Player input goes through here instead of IsKeyDown. The windowed build reads raylib,
+// the HEADLESS build plays an input script one simulation step at a time.
+bool game_key_down(int key);
+
+struct InputScript
+{
+  struct Entry
+  {
+    int steps = 1;
+    std::vector<int> keys; // held down during the whole entry
+  };
+  std::vector<Entry> entries;
+  bool loop = true;
+};
+
+// lines are "<steps> [LEFT] [RIGHT] [UP] [DOWN]", '#' starts a comment
+bool load_input_script(const std::string &path, InputScript &script);
+// random walk made of held direction keys, uses game_random
+InputScript make_random_input_script(int entries, int min_steps, int max_steps);
+
+void set_input_script(const InputScript &script);
+// moves the script forward by one simulation step
+void advance_input_script();
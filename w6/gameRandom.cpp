@@ -0,0 +1,26 @@
+#include "gameRandom.h"
+#include <random>
+#include <utility>
+
+static std::mt19937 &engine()
+{
+  static std::mt19937 gen(std::random_device{}());
+  return gen;
+}
+
+void seed_game_random(unsigned seed)
+{
+  engine().seed(seed);
+}
+
+int game_random(int min, int max)
+{
+  if (min > max)
+    std::swap(min, max);
+  return std::uniform_int_distribution<int>(min, max)(engine());
+}
+
+unsigned game_random_seed()
+{
+  return unsigned(engine()());
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Seeded replacement for raylib's GetRandomValue, so generation and AI can be replayed
+// from a single seed without a window. Only used from the main thread.
+void seed_game_random(unsigned seed);
+// inclusive on both ends like GetRandomValue
+int game_random(int min, int max);
+// seed for generators that keep their own engines
+unsigned game_random_seed();
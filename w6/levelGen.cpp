@@ -0,0 +1,269 @@
+#include "levelGen.h"
+#include <algorithm>
+#include <random>
+#include "dungeonGen.h"
+#include "dungeonUtils.h"
+#include "dijkstraMapGen.h"
+#include "gameRandom.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include "frameArena.h"
+#include "pathfinder.h"
+#include "tileCollision.h"
+
+static IntPos chunk_of(const Position &pos)
+{
+  return IntPos{int(pos.x / dungeon::tile_size) / int(ChunkedDungeon::chunk_size),
+                int(pos.y / dungeon::tile_size) / int(ChunkedDungeon::chunk_size)};
+}
+
+// Tile of the chunk farthest from the objects. The dmap spans every chunk between that one and the
+// objects, so paths leaving the chunk are measured too. A random tile of the chunk when none of the
+// objects can reach it.
+static Position place_far_from(ChunkedDungeon &store, IntPos chunk, const std::vector<Position> &objects,
+                               std::default_random_engine &rng)
+{
+  IntPos lo = chunk;
+  IntPos hi = chunk;
+  for (const Position &pos : objects)
+  {
+    const IntPos c = chunk_of(pos);
+    lo = IntPos{std::min(lo.x, c.x), std::min(lo.y, c.y)};
+    hi = IntPos{std::max(hi.x, c.x), std::max(hi.y, c.y)};
+  }
+  const DungeonData dd = extract_chunks(store, lo.x, lo.y, hi.x, hi.y);
+  std::vector<float> dm;
+  dmaps::gen_multiobject_approach_map(dd, objects, dm);
+
+  const size_t x0 = size_t(chunk.x - lo.x) * ChunkedDungeon::chunk_size;
+  const size_t y0 = size_t(chunk.y - lo.y) * ChunkedDungeon::chunk_size;
+  float best = 0.f;
+  size_t bestX = 0;
+  size_t bestY = 0;
+  for (size_t y = y0; y < y0 + ChunkedDungeon::chunk_size; ++y)
+    for (size_t x = x0; x < x0 + ChunkedDungeon::chunk_size; ++x)
+    {
+      const float v = dm[y * dd.width + x];
+      if (v < 1e5f && v > best)
+      {
+        best = v;
+        bestX = x;
+        bestY = y;
+      }
+    }
+  if (best <= 0.f)
+    return dungeon::find_walkable_tile(extract_chunks(store, chunk.x, chunk.y, chunk.x, chunk.y), rng);
+  return {float(dd.originX + int(bestX)) * dungeon::tile_size, float(dd.originY + int(bestY)) * dungeon::tile_size};
+}
+
+DungeonWindow build_dungeon_window(ChunkedDungeon &store, int centre_cx, int centre_cy)
+{
+  TRACE_SCOPE("dungeon_window_build");
+  ALLOC_TAG_SCOPE(ALLOC_LEVEL_INIT);
+  DungeonWindow window;
+  window.centreX = centre_cx;
+  window.centreY = centre_cy;
+  window.dungeon = extract_chunks(store,
+                                  std::max(centre_cx - window_radius, 0), std::max(centre_cy - window_radius, 0),
+                                  std::min(centre_cx + window_radius, store.chunksX - 1),
+                                  std::min(centre_cy + window_radius, store.chunksY - 1));
+  store.evict();
+  window.walkable = make_walkable_grid(window.dungeon);
+  window.portals = build_portals(window.dungeon);
+  return window;
+}
+
+LevelLayout build_level_layout(size_t w, size_t h, size_t spawn_cnt, unsigned seed)
+{
+  TRACE_SCOPE("level_build");
+  ALLOC_TAG_SCOPE(ALLOC_LEVEL_INIT);
+  std::default_random_engine rng(seed);
+  LevelLayout layout;
+  ChunkedDungeon &store = layout.store;
+  store = make_chunked_dungeon(w, h, unsigned(rng()));
+  std::uniform_int_distribution<int> chunkX(0, store.chunksX - 1);
+  std::uniform_int_distribution<int> chunkY(0, store.chunksY - 1);
+
+  const IntPos playerChunk{chunkX(rng), chunkY(rng)};
+  layout.playerPos = dungeon::find_walkable_tile(extract_chunks(store, playerChunk.x, playerChunk.y,
+                                                                playerChunk.x, playerChunk.y), rng);
+
+  // the exit goes into the opposite corner chunk, on its tile farthest from the player
+  const IntPos exitChunk{playerChunk.x < store.chunksX / 2 ? store.chunksX - 1 : 0,
+                         playerChunk.y < store.chunksY / 2 ? store.chunksY - 1 : 0};
+  std::vector<Position> obj_pos = {layout.playerPos};
+  layout.exitPos = place_far_from(store, exitChunk, obj_pos, rng);
+  obj_pos.push_back(layout.exitPos);
+
+  // each spawner goes to a random chunk, on its tile farthest from everything placed so far
+  for (size_t k = 0; k < spawn_cnt; ++k)
+  {
+    const IntPos spawnChunk{chunkX(rng), chunkY(rng)};
+    Position spawn_pos = place_far_from(store, spawnChunk, obj_pos, rng);
+    obj_pos.push_back(spawn_pos);
+    layout.spawnerPos.push_back(spawn_pos);
+  }
+
+  const IntPos startChunk = chunk_of(layout.playerPos);
+  layout.window = build_dungeon_window(store, startChunk.x, startChunk.y);
+  return layout;
+}
+
+
+LevelPreloader::LevelPreloader()
+{
+  worker = std::thread([this]() { run(); });
+}
+
+LevelPreloader::~LevelPreloader()
+{
+  stop();
+}
+
+void LevelPreloader::stop()
+{
+  if (!worker.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void LevelPreloader::request(size_t w, size_t h, size_t spawn_cnt)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // a request in flight is finished first, its layout is dropped
+    cv.wait(lock, [&]() { return !requested; });
+    width = w;
+    height = h;
+    spawnCnt = spawn_cnt;
+    seed = game_random_seed();
+    built = false;
+    requested = true;
+  }
+  cv.notify_all();
+}
+
+LevelLayout LevelPreloader::take()
+{
+  TRACE_SCOPE("level_preload_wait");
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return built; });
+  built = false;
+  return std::move(layout);
+}
+
+void LevelPreloader::run()
+{
+  trace::set_thread_name("level_preload");
+  // the frame loop rewinds the shared arenas while this thread may still be building
+  PrivateFrameArenaScope arenaScope;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    cv.wait(lock, [&]() { return requested || quit; });
+    if (quit)
+      return;
+    const size_t w = width;
+    const size_t h = height;
+    const size_t cnt = spawnCnt;
+    const unsigned s = seed;
+    lock.unlock();
+    LevelLayout next = build_level_layout(w, h, cnt, s);
+    // the layout lives in regular containers, whatever the build left in the arena is garbage now
+    arenaScope.arena.reset();
+    lock.lock();
+    layout = std::move(next);
+    built = true;
+    requested = false;
+    cv.notify_all();
+  }
+}
+
+
+DungeonStreamer::DungeonStreamer()
+{
+  worker = std::thread([this]() { run(); });
+}
+
+DungeonStreamer::~DungeonStreamer()
+{
+  stop();
+}
+
+void DungeonStreamer::stop()
+{
+  if (!worker.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void DungeonStreamer::reset(ChunkedDungeon &&new_store)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]() { return !building; });
+  store = std::move(new_store);
+  requested = false;
+  built = false;
+}
+
+void DungeonStreamer::request(int centre_cx, int centre_cy)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const bool same = requestX == centre_cx && requestY == centre_cy;
+    if (same && (requested || building))
+      return;
+    requestX = centre_cx;
+    requestY = centre_cy;
+    requested = true;
+  }
+  cv.notify_all();
+}
+
+bool DungeonStreamer::poll(DungeonWindow &out, bool wait)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (wait)
+    cv.wait(lock, [&]() { return built || (!requested && !building); });
+  if (!built)
+    return false;
+  out = std::move(window);
+  built = false;
+  return true;
+}
+
+void DungeonStreamer::run()
+{
+  trace::set_thread_name("dungeon_stream");
+  PrivateFrameArenaScope arenaScope;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    cv.wait(lock, [&]() { return requested || quit; });
+    if (quit)
+      return;
+    const int cx = requestX;
+    const int cy = requestY;
+    requested = false;
+    building = true;
+    lock.unlock();
+    // the store is only touched here and by reset, which waits for building to drop
+    DungeonWindow next = build_dungeon_window(store, cx, cy);
+    arenaScope.arena.reset();
+    lock.lock();
+    window = std::move(next);
+    built = true;
+    building = false;
+    cv.notify_all();
+  }
+}
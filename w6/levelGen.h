@@ -0,0 +1,122 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ecsTypes.h"
+#include "chunkedDungeon.h"
+#include "pathfinder.h"
+#include "tileCollision.h"
+
+// chunks streamed in on each side of the player's chunk
+constexpr int window_radius = 1;
+
+// The part of the level around the player that the simulation sees: tiles, portal graph and
+// collision grid, all in window coordinates.
+struct DungeonWindow
+{
+  DungeonData dungeon;
+  DungeonPortals portals;
+  WalkableGrid walkable;
+  int centreX = 0; // chunk the window is built around
+  int centreY = 0;
+};
+
+DungeonWindow build_dungeon_window(ChunkedDungeon &store, int centre_cx, int centre_cy);
+
+// A new level: its chunk store, the first window and where the player, exit and spawners go. It
+// holds no entities or GPU resources, so it can be built away from the world and moved into it by
+// init_shoot_em_up.
+struct LevelLayout
+{
+  ChunkedDungeon store;
+  DungeonWindow window;
+  Position playerPos;
+  Position exitPos;
+  std::vector<Position> spawnerPos;
+};
+
+// doesn't touch the world or the shared random generator, safe to call from any thread
+LevelLayout build_level_layout(size_t w, size_t h, size_t spawn_cnt, unsigned seed);
+
+// Builds the next level on a worker thread while the current one is played. The thread lives as
+// long as the preloader and sleeps between requests.
+struct LevelPreloader
+{
+  LevelPreloader();
+  ~LevelPreloader();
+  LevelPreloader(const LevelPreloader &) = delete;
+  LevelPreloader &operator=(const LevelPreloader &) = delete;
+
+  // joins the worker once it's done with what it's building, the destructor calls it too
+  void stop();
+
+  // the seed is drawn from game_random here, on the calling thread, so seeded runs replay
+  void request(size_t w, size_t h, size_t spawn_cnt);
+  // waits for the requested layout if it isn't built yet
+  LevelLayout take();
+
+  // of the last request
+  size_t width = 0;
+  size_t height = 0;
+  size_t spawnCnt = 0;
+
+private:
+  void run();
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv;
+  unsigned seed = 0;
+  bool requested = false;
+  bool built = false;
+  bool quit = false;
+  LevelLayout layout;
+};
+
+struct DungeonStreamer;
+
+// singleton of a level, the streamer itself outlives the world
+struct DungeonStreaming
+{
+  DungeonStreamer *streamer = nullptr;
+  int centreX = 0; // chunk the current window is built around
+  int centreY = 0;
+};
+
+// Keeps the dungeon window of the current level centred on the player. The chunk store belongs to
+// a worker thread that builds windows on request, the main thread only polls for finished ones and
+// swaps them into the world.
+struct DungeonStreamer
+{
+  DungeonStreamer();
+  ~DungeonStreamer();
+  DungeonStreamer(const DungeonStreamer &) = delete;
+  DungeonStreamer &operator=(const DungeonStreamer &) = delete;
+
+  // joins the worker once it's done with what it's building, the destructor calls it too
+  void stop();
+
+  // hands the store of a new level over, waits for a window of the old level still being built
+  void reset(ChunkedDungeon &&store);
+  // doesn't block, a request for the window already being built is ignored
+  void request(int centre_cx, int centre_cy);
+  // moves the last finished window out, false if there's none. With wait set it first waits for a
+  // window that is requested or being built.
+  bool poll(DungeonWindow &window, bool wait = false);
+
+private:
+  void run();
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv;
+  ChunkedDungeon store;
+  int requestX = 0;
+  int requestY = 0;
+  bool requested = false;
+  bool building = false;
+  bool built = false;
+  bool quit = false;
+  DungeonWindow window;
+};
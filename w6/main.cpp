@@ -1,20 +1,28 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <thread>
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
 #include "dungeonGen.h"
+#include "fixedStep.h"
+#include "spriteAtlas.h"
+#include "culling.h"
+#include "worldRegistry.h"
+#include "profiler.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include "frameArena.h"
+#include "levelGen.h"
 
 
 static void update_camera(flecs::world &ecs)
 {
-  static auto cameraQuery = ecs.query<Camera2D>();
-  static auto playerQuery = ecs.query<const Position, const IsPlayer>();
-
-  /*cameraQuery*/ecs.each([&](Camera2D &cam)
+  const WorldRegistry &reg = registry(ecs);
+  reg.cameras.each([&](Camera2D &cam)
   {
-    /*playerQuery*/ecs.each([&](const Position &pos, const IsPlayer &)
+    reg.players.each([&](const Position &pos, const IsPlayer &)
     {
       cam.target.x += (pos.x - cam.target.x) * 0.1f;
       cam.target.y += (pos.y - cam.target.y) * 0.1f;
@@ -38,19 +46,33 @@ int main(int /*argc*/, const char ** /*argv*/)
     SetWindowSize(width, height);
   }
 
+#if defined(ENABLE_TRACING)
+  trace::begin_session("trace.json");
+#endif
+  // chunk store of the current level, declared first so it outlives the world pointing at it
+  DungeonStreamer streamer;
   flecs::world ecs;
 
   size_t dungWidth = 50;
   size_t dungHeight = 50;
   size_t spawn_cnt = 3;
 
+  // the next level is built on a worker thread while the current one is played
+  LevelPreloader preloader;
+  auto preload_next_level = [&](){
+    preloader.request(size_t(dungWidth * 1.2), size_t(dungHeight * 1.2), size_t(spawn_cnt * 1.2 + 1));
+  };
   auto level_up = [&](){
-    dungWidth *= 1.2;
-    dungHeight *= 1.2;
-    spawn_cnt = spawn_cnt * 1.2 + 1;
+    dungWidth = preloader.width;
+    dungHeight = preloader.height;
+    spawn_cnt = preloader.spawnCnt;
   };
 
-  init_shoot_em_up(ecs, dungWidth, dungHeight, spawn_cnt);
+  // steering and movement systems are split between worker threads
+  const int threadCount = int(std::max(1u, std::thread::hardware_concurrency()));
+  ecs.set_threads(threadCount);
+  init_shoot_em_up(ecs, dungWidth, dungHeight, spawn_cnt, streamer);
+  preload_next_level();
 
   //Texture2D bgTex = LoadTexture("assets/background.png"); // TODO: move to ecs
 
@@ -62,33 +84,55 @@ int main(int /*argc*/, const char ** /*argv*/)
   ecs.entity("camera")
     .set(Camera2D{camera});
 
-  static auto cameraQuery = ecs.query<Camera2D>();
-
   SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
+  FixedStepClock clock;
   while (!WindowShouldClose())
   {
-    process_game(ecs);
+    const float frameTime = GetFrameTime();
+    const bool running = run_fixed_steps(ecs, clock, frameTime, process_game);
     update_camera(ecs);
 
     BeginDrawing();
       ClearBackground(BLACK);
-      /*cameraQuery*/ecs.each([&](Camera2D &cam) { BeginMode2D(cam); });
+      registry(ecs).cameras.each([&](Camera2D &cam) { BeginMode2D(cam); });
         //DrawTextureTiled(bgTex, {0, 0, 512, 512}, {0, 0, 10240, 10240}, {0, 0}, 0.f, 1.f, WHITE);
         //constexpr int tiles = 20;
         //DrawTextureQuad(bgTex, {tiles, tiles}, {0, 0},
         //    {-512 * tiles / 2, -512 * tiles / 2, 512 * tiles, 512 * tiles}, GRAY);
-        if (!ecs.progress())
-        {
-          ecs.reset();
-          level_up();
-          ecs.entity("camera").set(Camera2D{camera});
-          init_shoot_em_up(ecs, dungWidth, dungHeight, spawn_cnt);
-        }
+        render_frame(ecs, clock, frameTime);
       EndMode2D();
+      if (const CullStats *cull = ecs.get<CullStats>())
+        DrawText(TextFormat("drawn: %d culled: %d", int(cull->drawn), int(cull->culled)), 20, 20, 20, WHITE);
+      prof::draw_overlay(20, 50);
+      alloc::draw_overlay(width - 440, 50);
       // Advance to next frame. Process submitted rendering primitives.
     EndDrawing();
+    prof::handle_keys();
+    prof::end_frame();
+    alloc::handle_keys();
+    alloc::end_frame();
+    reset_frame_arenas();
+
+    if (!running)
+    {
+      TRACE_SCOPE("level_reset");
+      LevelLayout layout = preloader.take();
+      ecs.reset();
+      ecs.set_threads(threadCount);
+      level_up();
+      ecs.entity("camera").set(Camera2D{camera});
+      init_shoot_em_up(ecs, std::move(layout), streamer);
+      preload_next_level();
+    }
   }
 
+  // the level workers record trace events too, the session is written once they're gone
+  preloader.stop();
+  streamer.stop();
+  trace::end_session();
+  // the tile map unloads its render textures when it's removed, that needs the GL context
+  ecs.reset();
+  unload_sprite_atlas();
   CloseWindow();
 
   return 0;
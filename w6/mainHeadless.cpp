@@ -0,0 +1,168 @@
+// Windowless w6: simulation systems only, scripted player input and a seeded RNG.
+// Steps as fast as it can and prints timings, for profiling AI and pathfinding on boxes without a display.
+#include <flecs.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "ecsTypes.h"
+#include "shootEmUp.h"
+#include "fixedStep.h"
+#include "gameInput.h"
+#include "gameRandom.h"
+#include "profiler.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include "frameArena.h"
+#include "levelGen.h"
+
+
+static void print_usage(const char *exe)
+{
+  printf("usage: %s [--seed N] [--steps N] [--levels N] [--threads N] [--script file] [--profile out.csv] [--trace out.json]\n", exe);
+}
+
+int main(int argc, const char **argv)
+{
+  unsigned seed = 1;
+  long long maxSteps = 100000;
+  int maxLevels = 5;
+  int threadCount = int(std::max(1u, std::thread::hardware_concurrency()));
+  const char *scriptPath = nullptr;
+  const char *profilePath = nullptr;
+  const char *tracePath = nullptr;
+  for (int i = 1; i < argc; i += 2)
+  {
+    // every option takes a value
+    if (i + 1 == argc)
+    {
+      print_usage(argv[0]);
+      return 1;
+    }
+    if (!strcmp(argv[i], "--seed"))
+      seed = unsigned(strtoul(argv[i + 1], nullptr, 10));
+    else if (!strcmp(argv[i], "--steps"))
+      maxSteps = strtoll(argv[i + 1], nullptr, 10);
+    else if (!strcmp(argv[i], "--levels"))
+      maxLevels = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "--threads"))
+      threadCount = std::max(1, atoi(argv[i + 1]));
+    else if (!strcmp(argv[i], "--script"))
+      scriptPath = argv[i + 1];
+    else if (!strcmp(argv[i], "--profile"))
+      profilePath = argv[i + 1];
+    else if (!strcmp(argv[i], "--trace"))
+      tracePath = argv[i + 1];
+    else
+    {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  seed_game_random(seed);
+  InputScript script;
+  if (scriptPath && !load_input_script(scriptPath, script))
+  {
+    printf("can't read input script %s\n", scriptPath);
+    return 1;
+  }
+  if (!scriptPath)
+    script = make_random_input_script(256, 10, 120);
+  set_input_script(script);
+
+  // events are only recorded when built with ENABLE_TRACING
+  if (tracePath)
+    trace::begin_session(tracePath);
+  // chunk store of the current level, declared first so it outlives the world pointing at it
+  DungeonStreamer streamer;
+  flecs::world ecs;
+
+  size_t dungWidth = 50;
+  size_t dungHeight = 50;
+  size_t spawn_cnt = 3;
+
+  // the next level is built on a worker thread while the current one is played
+  LevelPreloader preloader;
+  auto preload_next_level = [&](){
+    preloader.request(size_t(dungWidth * 1.2), size_t(dungHeight * 1.2), size_t(spawn_cnt * 1.2 + 1));
+  };
+  auto level_up = [&](){
+    dungWidth = preloader.width;
+    dungHeight = preloader.height;
+    spawn_cnt = preloader.spawnCnt;
+  };
+
+  ecs.set_threads(threadCount);
+  init_shoot_em_up(ecs, dungWidth, dungHeight, spawn_cnt, streamer);
+  preload_next_level();
+
+  using clock = std::chrono::steady_clock;
+  const FixedStepClock stepClock;
+  int level = 0;
+  long long levelSteps = 0;
+  alloc::TagStats levelAllocs[ALLOC_TAG_NUM];
+  uint64_t levelTableMoves = 0;
+  auto levelStart = clock::now();
+  const auto start = levelStart;
+  for (long long step = 0; step < maxSteps && level < maxLevels; ++step)
+  {
+    const bool running = step_simulation(ecs, stepClock.step, 1, process_game);
+    advance_input_script();
+    prof::end_frame();
+    alloc::end_frame();
+    reset_frame_arenas();
+    for (int tag = 0; tag < ALLOC_TAG_NUM; ++tag)
+    {
+      levelAllocs[tag].count += alloc::last_frame(AllocTag(tag)).count;
+      levelAllocs[tag].bytes += alloc::last_frame(AllocTag(tag)).bytes;
+    }
+    levelTableMoves += prof::table_moves_last_frame();
+    ++levelSteps;
+
+    if (!running)
+    {
+      TRACE_SCOPE("level_reset");
+      const double sec = std::chrono::duration<double>(clock::now() - levelStart).count();
+      printf("level %d (%zux%zu, %zu spawners): %lld steps in %.3f s, %.1f steps/s\n",
+             level, dungWidth, dungHeight, spawn_cnt, levelSteps, sec, levelSteps / std::max(sec, 1e-9));
+      for (int tag = 0; tag < ALLOC_TAG_NUM; ++tag)
+      {
+        if (levelAllocs[tag].count > 0)
+          printf("  %-12s %.1f allocs/step, %.0f bytes/step\n", alloc::tag_name(AllocTag(tag)),
+                 levelAllocs[tag].count / double(levelSteps), levelAllocs[tag].bytes / double(levelSteps));
+        levelAllocs[tag] = alloc::TagStats{};
+      }
+      printf("  table moves  %.1f/step\n", levelTableMoves / double(levelSteps));
+      levelTableMoves = 0;
+      // switching to the preloaded level is meant to fit into one frame
+      const auto transitionStart = clock::now();
+      LevelLayout layout = preloader.take();
+      const double waitMs = std::chrono::duration<double, std::milli>(clock::now() - transitionStart).count();
+      ecs.reset();
+      ecs.set_threads(threadCount);
+      level_up();
+      ++level;
+      init_shoot_em_up(ecs, std::move(layout), streamer);
+      preload_next_level();
+      const double transitionMs = std::chrono::duration<double, std::milli>(clock::now() - transitionStart).count();
+      printf("  transition   %.2f ms, %.2f ms of it waiting for the preloader\n", transitionMs, waitMs);
+      levelSteps = 0;
+      levelStart = clock::now();
+    }
+  }
+  const double total = std::chrono::duration<double>(clock::now() - start).count();
+  printf("seed %u, %d levels finished, %.3f s total\n", seed, level, total);
+  // the level workers record trace events too, the session is written once they're gone
+  preloader.stop();
+  streamer.stop();
+  trace::end_session();
+  // the csv holds the last prof::history_frames steps
+  if (profilePath && !prof::dump_csv(profilePath))
+    printf("can't write profile %s\n", profilePath);
+
+  return 0;
+}
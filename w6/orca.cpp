@@ -0,0 +1,176 @@
+#include "orca.h"
+#include <cmath>
+#include <algorithm>
+#include "allocTracker.h"
+
+namespace
+{
+  // half-plane of permitted velocities, to the left of direction through point
+  struct Line
+  {
+    Position point;
+    Position direction;
+  };
+
+  constexpr float eps = 1e-5f;
+
+  float dot(const Position &a, const Position &b) { return a.x * b.x + a.y * b.y; }
+  float det(const Position &a, const Position &b) { return a.x * b.y - a.y * b.x; }
+
+  // optimises along lines[lineNo] constrained by lines before it and the speed circle
+  bool linear_program1(const Line *lines, size_t lineNo, float radius, const Position &optVel, bool directionOpt,
+                       Position &result)
+  {
+    const Line &line = lines[lineNo];
+    const float dotProduct = dot(line.point, line.direction);
+    const float discriminant = dotProduct * dotProduct + radius * radius - length_sq(line.point);
+    if (discriminant < 0.f)
+      return false; // the speed circle doesn't reach the line
+    const float sqrtDiscriminant = sqrtf(discriminant);
+    float tLeft = -dotProduct - sqrtDiscriminant;
+    float tRight = -dotProduct + sqrtDiscriminant;
+    for (size_t i = 0; i < lineNo; ++i)
+    {
+      const float denominator = det(line.direction, lines[i].direction);
+      const float numerator = det(lines[i].direction, line.point - lines[i].point);
+      if (fabsf(denominator) <= eps)
+      {
+        if (numerator < 0.f)
+          return false; // parallel and pointing away
+        continue;
+      }
+      const float t = numerator / denominator;
+      if (denominator >= 0.f)
+        tRight = std::min(tRight, t);
+      else
+        tLeft = std::max(tLeft, t);
+      if (tLeft > tRight)
+        return false;
+    }
+    if (directionOpt)
+      result = line.point + line.direction * (dot(optVel, line.direction) > 0.f ? tRight : tLeft);
+    else
+      result = line.point + line.direction * std::clamp(dot(line.direction, optVel - line.point), tLeft, tRight);
+    return true;
+  }
+
+  // returns index of the first line that couldn't be satisfied, count if all were
+  size_t linear_program2(const Line *lines, size_t count, float radius, const Position &optVel, bool directionOpt,
+                         Position &result)
+  {
+    if (directionOpt)
+      result = optVel * radius;
+    else if (length_sq(optVel) > radius * radius)
+      result = normalize(optVel) * radius;
+    else
+      result = optVel;
+    for (size_t i = 0; i < count; ++i)
+      if (det(lines[i].direction, lines[i].point - result) > 0.f)
+      {
+        const Position tempResult = result;
+        if (!linear_program1(lines, i, radius, optVel, directionOpt, result))
+        {
+          result = tempResult;
+          return i;
+        }
+      }
+    return count;
+  }
+
+  // infeasible program: minimise the largest violation of lines starting from beginLine
+  void linear_program3(const Line *lines, size_t count, size_t beginLine, float radius, Position &result)
+  {
+    float distance = 0.f;
+    Line projLines[orca::max_neighbours];
+    for (size_t i = beginLine; i < count; ++i)
+    {
+      if (det(lines[i].direction, lines[i].point - result) <= distance)
+        continue;
+      size_t projCount = 0;
+      for (size_t j = 0; j < i; ++j)
+      {
+        Line line;
+        const float determinant = det(lines[i].direction, lines[j].direction);
+        if (fabsf(determinant) <= eps)
+        {
+          if (dot(lines[i].direction, lines[j].direction) > 0.f)
+            continue; // same direction
+          line.point = (lines[i].point + lines[j].point) * 0.5f;
+        }
+        else
+          line.point = lines[i].point +
+            lines[i].direction * (det(lines[j].direction, lines[i].point - lines[j].point) / determinant);
+        line.direction = normalize(lines[j].direction - lines[i].direction);
+        projLines[projCount++] = line;
+      }
+      const Position tempResult = result;
+      const Position optDir{-lines[i].direction.y, lines[i].direction.x};
+      if (linear_program2(projLines, projCount, radius, optDir, true, result) < projCount)
+        result = tempResult; // can only happen from float round-off
+      distance = det(lines[i].direction, lines[i].point - result);
+    }
+  }
+}
+
+Velocity orca::avoid(const Position &pos, const Velocity &pref_vel, const Neighbour *neighbours, size_t count,
+                     const Params &params)
+{
+  ZERO_ALLOC_SCOPE("orca::avoid");
+  Line lines[max_neighbours];
+  count = std::min(count, max_neighbours);
+  const float invTimeHorizon = 1.f / params.timeHorizon;
+  const float combinedRadius = 2.f * params.radius;
+  const float combinedRadiusSq = combinedRadius * combinedRadius;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Position relPos = neighbours[i].pos - pos;
+    const Position relVel = pref_vel - neighbours[i].vel;
+    const float distSq = length_sq(relPos);
+    Line &line = lines[i];
+    Position u;
+    if (distSq > combinedRadiusSq)
+    {
+      // vector from the cutoff circle centre to the relative velocity
+      const Position w = relVel - relPos * invTimeHorizon;
+      const float wLengthSq = length_sq(w);
+      const float dotProduct = dot(w, relPos);
+      if (dotProduct < 0.f && dotProduct * dotProduct > combinedRadiusSq * wLengthSq)
+      {
+        // project on the cutoff circle
+        const float wLength = sqrtf(wLengthSq);
+        const Position unitW = w * (1.f / wLength);
+        line.direction = Position{unitW.y, -unitW.x};
+        u = unitW * (combinedRadius * invTimeHorizon - wLength);
+      }
+      else
+      {
+        // project on the closer leg of the cone
+        const float leg = sqrtf(distSq - combinedRadiusSq);
+        if (det(relPos, w) > 0.f)
+          line.direction = Position{relPos.x * leg - relPos.y * combinedRadius,
+                                    relPos.x * combinedRadius + relPos.y * leg} * (1.f / distSq);
+        else
+          line.direction = Position{-relPos.x * leg - relPos.y * combinedRadius,
+                                    relPos.x * combinedRadius - relPos.y * leg} * (1.f / distSq);
+        u = line.direction * dot(relVel, line.direction) - relVel;
+      }
+    }
+    else
+    {
+      // already overlapping, resolve within one step
+      const float invTimeStep = 1.f / params.dt;
+      const Position w = relVel - relPos * invTimeStep;
+      const float wLength = length(w);
+      const Position unitW = w * safeinv(wLength);
+      line.direction = Position{unitW.y, -unitW.x};
+      u = unitW * (combinedRadius * invTimeStep - wLength);
+    }
+    line.point = pref_vel + u * 0.5f;
+  }
+
+  Position result;
+  const size_t lineFail = linear_program2(lines, count, params.maxSpeed, pref_vel, false, result);
+  if (lineFail < count)
+    linear_program3(lines, count, lineFail, params.maxSpeed, result);
+  return Velocity{result};
+}
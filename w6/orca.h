@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include "ecsTypes.h"
+
+// Optimal reciprocal collision avoidance: every agent picks the velocity closest to the one
+// it wants that can't hit any of its nearest neighbours within timeHorizon, assuming the
+// neighbours take half of the avoidance effort.
+namespace orca
+{
+  constexpr size_t max_neighbours = 10;
+
+  struct Neighbour
+  {
+    Position pos;
+    Velocity vel;
+  };
+
+  struct Params
+  {
+    float radius = 0.f;
+    float timeHorizon = 1.5f;
+    float maxSpeed = 0.f;
+    float dt = 1.f / 60.f; // used to push already overlapping agents apart within one step
+  };
+
+  // neighbours are at most max_neighbours closest agents
+  Velocity avoid(const Position &pos, const Velocity &pref_vel, const Neighbour *neighbours, size_t count,
+                 const Params &params);
+};
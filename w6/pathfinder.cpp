@@ -1,6 +1,10 @@
 #include "pathfinder.h"
 #include "dungeonUtils.h"
 #include "math.h"
+#include "profiler.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include "frameArena.h"
 #include <algorithm>
 
 float heuristic(IVec2 lhs, IVec2 rhs)
@@ -14,37 +18,55 @@ static size_t coord_to_idx(T x, T y, size_t w)
   return size_t(y) * w + size_t(x);
 }
 
-static std::vector<IVec2> reconstruct_path(std::vector<IVec2> prev, IVec2 to, size_t width)
+// paths and scratch of a single query live in the frame arena
+using TilePath = frame_vector<IVec2>;
+
+// prev is indexed in the lim_min based search window of width w
+static TilePath reconstruct_path(const frame_vector<IVec2> &prev, IVec2 to, IVec2 lim_min, size_t w)
 {
   IVec2 curPos = to;
-  std::vector<IVec2> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != IVec2{-1, -1})
+  TilePath res;
+  res.push_back(curPos);
+  while (prev[coord_to_idx(curPos.x - lim_min.x, curPos.y - lim_min.y, w)] != IVec2{-1, -1})
   {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
+    curPos = prev[coord_to_idx(curPos.x - lim_min.x, curPos.y - lim_min.y, w)];
+    res.push_back(curPos);
   }
+  std::reverse(res.begin(), res.end());
   return res;
 }
 
-static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
-                                           IVec2 lim_min, IVec2 lim_max)
+static bool in_window(IVec2 p, IVec2 lim_min, IVec2 lim_max)
+{
+  return p.x >= lim_min.x && p.y >= lim_min.y && p.x < lim_max.x && p.y < lim_max.y;
+}
+
+// the search never leaves lim_min..lim_max, so scratch only covers that window instead of the whole dungeon
+static TilePath find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
+                                 IVec2 lim_min, IVec2 lim_max)
 {
+  TRACE_SCOPE("path_a_star");
   if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height))
-    return std::vector<IVec2>();
-  size_t inpSize = dd.width * dd.height;
+    return TilePath();
+  if (!in_window(from, lim_min, lim_max) || !in_window(to, lim_min, lim_max))
+    return TilePath();
+  const size_t winW = size_t(lim_max.x - lim_min.x);
+  const size_t inpSize = winW * size_t(lim_max.y - lim_min.y);
+  auto localIdx = [&](IVec2 p) { return coord_to_idx(p.x - lim_min.x, p.y - lim_min.y, winW); };
 
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1,-1});
+  frame_vector<float> g(inpSize, std::numeric_limits<float>::max());
+  frame_vector<float> f(inpSize, std::numeric_limits<float>::max());
+  frame_vector<IVec2> prev(inpSize, {-1,-1});
 
-  auto getG = [&](IVec2 p) -> float { return g[coord_to_idx(p.x, p.y, dd.width)]; };
-  auto getF = [&](IVec2 p) -> float { return f[coord_to_idx(p.x, p.y, dd.width)]; };
+  auto getG = [&](IVec2 p) -> float { return g[localIdx(p)]; };
+  auto getF = [&](IVec2 p) -> float { return f[localIdx(p)]; };
 
-  g[coord_to_idx(from.x, from.y, dd.width)] = 0;
-  f[coord_to_idx(from.x, from.y, dd.width)] = heuristic(from, to);
+  g[localIdx(from)] = 0;
+  f[localIdx(from)] = heuristic(from, to);
 
-  std::vector<IVec2> openList = {from};
-  std::vector<IVec2> closedList;
+  frame_vector<IVec2> openList;
+  openList.push_back(from);
+  frame_vector<IVec2> closedList;
 
   while (!openList.empty())
   {
@@ -60,21 +82,20 @@ static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IV
       }
     }
     if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, dd.width);
+      return reconstruct_path(prev, to, lim_min, winW);
     IVec2 curPos = openList[bestIdx];
     openList.erase(openList.begin() + bestIdx);
     if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
       continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, dd.width);
     closedList.emplace_back(curPos);
     auto checkNeighbour = [&](IVec2 p)
     {
       // out of bounds
       if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
         return;
-      size_t idx = coord_to_idx(p.x, p.y, dd.width);
+      size_t idx = localIdx(p);
       // not empty
-      if (dd.tiles[idx] == dungeon::wall)
+      if (dd.tiles[coord_to_idx(p.x, p.y, dd.width)] == dungeon::wall)
         return;
       float edgeWeight = 1.f;
       float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
@@ -94,156 +115,167 @@ static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IV
     checkNeighbour({curPos.x + 0, curPos.y - 1});
   }
   // empty path
-  return std::vector<IVec2>();
+  return TilePath();
 }
 
 
-void prebuild_map(flecs::world &ecs)
+DungeonPortals build_portals(const DungeonData &dd)
 {
-  auto mapQuery = ecs.query<const DungeonData>();
-
-  constexpr size_t splitTiles = 10;
-  ecs.defer([&]()
+  TRACE_SCOPE("portal_build");
+  ALLOC_TAG_SCOPE(ALLOC_PATHFINDING);
+  // divides ChunkedDungeon::chunk_size, so supertiles never straddle a chunk of the window
+  constexpr size_t splitTiles = 8;
+  // go through each super tile
+  const size_t width = dd.width / splitTiles;
+  const size_t height = dd.height / splitTiles;
+
+  auto check_border = [&](size_t xx, size_t yy,
+                          size_t dir_x, size_t dir_y,
+                          int offs_x, int offs_y,
+                          std::vector<PathPortal> &portals)
   {
-    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    int spanFrom = -1;
+    int spanTo = -1;
+    for (size_t i = 0; i < splitTiles; ++i)
     {
-      // go through each super tile
-      const size_t width = dd.width / splitTiles;
-      const size_t height = dd.height / splitTiles;
-
-      auto check_border = [&](size_t xx, size_t yy,
-                              size_t dir_x, size_t dir_y,
-                              int offs_x, int offs_y,
-                              std::vector<PathPortal> &portals)
+      size_t x = xx * splitTiles + i * dir_x;
+      size_t y = yy * splitTiles + i * dir_y;
+      size_t nx = x + offs_x;
+      size_t ny = y + offs_y;
+      if (dd.tiles[y * dd.width + x] != dungeon::wall &&
+          dd.tiles[ny * dd.width + nx] != dungeon::wall)
       {
-        int spanFrom = -1;
-        int spanTo = -1;
-        for (size_t i = 0; i < splitTiles; ++i)
-        {
-          size_t x = xx * splitTiles + i * dir_x;
-          size_t y = yy * splitTiles + i * dir_y;
-          size_t nx = x + offs_x;
-          size_t ny = y + offs_y;
-          if (dd.tiles[y * dd.width + x] != dungeon::wall &&
-              dd.tiles[ny * dd.width + nx] != dungeon::wall)
-          {
-            if (spanFrom < 0)
-              spanFrom = i;
-            spanTo = i;
-          }
-          else if (spanFrom >= 0)
-          {
-            // write span
-            portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                               yy * splitTiles + spanFrom * dir_y + offs_y,
-                               xx * splitTiles + spanTo * dir_x,
-                               yy * splitTiles + spanTo * dir_y});
-            spanFrom = -1;
-          }
-        }
-        if (spanFrom >= 0)
-        {
-          portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                             yy * splitTiles + spanFrom * dir_y + offs_y,
-                             xx * splitTiles + spanTo * dir_x,
-                             yy * splitTiles + spanTo * dir_y});
-        }
-      };
+        if (spanFrom < 0)
+          spanFrom = i;
+        spanTo = i;
+      }
+      else if (spanFrom >= 0)
+      {
+        // write span
+        portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
+                           yy * splitTiles + spanFrom * dir_y + offs_y,
+                           xx * splitTiles + spanTo * dir_x,
+                           yy * splitTiles + spanTo * dir_y});
+        spanFrom = -1;
+      }
+    }
+    if (spanFrom >= 0)
+    {
+      portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
+                         yy * splitTiles + spanFrom * dir_y + offs_y,
+                         xx * splitTiles + spanTo * dir_x,
+                         yy * splitTiles + spanTo * dir_y});
+    }
+  };
 
-      std::vector<PathPortal> portals;
-      std::vector<std::vector<size_t>> tilePortalsIndices;
+  std::vector<PathPortal> portals;
+  std::vector<std::vector<size_t>> tilePortalsIndices;
 
-      auto push_portals = [&](size_t x, size_t y,
-                              int offs_x, int offs_y,
-                              const std::vector<PathPortal> &new_portals)
+  auto push_portals = [&](size_t x, size_t y,
+                          int offs_x, int offs_y,
+                          const std::vector<PathPortal> &new_portals)
+  {
+    for (const PathPortal &portal : new_portals)
+    {
+      size_t idx = portals.size();
+      portals.push_back(portal);
+      tilePortalsIndices[y * width + x].push_back(idx);
+      tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
+    }
+  };
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      tilePortalsIndices.push_back(std::vector<size_t>{});
+      // check top
+      if (y > 0)
       {
-        for (const PathPortal &portal : new_portals)
-        {
-          size_t idx = portals.size();
-          portals.push_back(portal);
-          tilePortalsIndices[y * width + x].push_back(idx);
-          tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
-        }
-      };
-      for (size_t y = 0; y < height; ++y)
-        for (size_t x = 0; x < width; ++x)
-        {
-          tilePortalsIndices.push_back(std::vector<size_t>{});
-          // check top
-          if (y > 0)
-          {
-            std::vector<PathPortal> topPortals;
-            check_border(x, y, 1, 0, 0, -1, topPortals);
-            push_portals(x, y, 0, -1, topPortals);
-          }
-          // left
-          if (x > 0)
-          {
-            std::vector<PathPortal> leftPortals;
-            check_border(x, y, 0, 1, -1, 0, leftPortals);
-            push_portals(x, y, -1, 0, leftPortals);
-          }
-        }
-      for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
+        std::vector<PathPortal> topPortals;
+        check_border(x, y, 1, 0, 0, -1, topPortals);
+        push_portals(x, y, 0, -1, topPortals);
+      }
+      // left
+      if (x > 0)
+      {
+        std::vector<PathPortal> leftPortals;
+        check_border(x, y, 0, 1, -1, 0, leftPortals);
+        push_portals(x, y, -1, 0, leftPortals);
+      }
+    }
+  for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
+  {
+    const std::vector<size_t> &indices = tilePortalsIndices[tidx];
+    size_t x = tidx % width;
+    size_t y = tidx / width;
+    IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
+    IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+      PathPortal &firstPortal = portals[indices[i]];
+      for (size_t j = i + 1; j < indices.size(); ++j)
       {
-        const std::vector<size_t> &indices = tilePortalsIndices[tidx];
-        size_t x = tidx % width;
-        size_t y = tidx / width;
-        IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
-        IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
-        for (size_t i = 0; i < indices.size(); ++i)
+        PathPortal &secondPortal = portals[indices[j]];
+        // check path from i to j
+        // check each position (to find closest dist) (could be made more optimal)
+        bool noPath = false;
+        size_t minDist = 0xffffffff;
+        for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
+                    fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
         {
-          PathPortal &firstPortal = portals[indices[i]];
-          for (size_t j = i + 1; j < indices.size(); ++j)
+          for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
+                      fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
           {
-            PathPortal &secondPortal = portals[indices[j]];
-            // check path from i to j
-            // check each position (to find closest dist) (could be made more optimal)
-            bool noPath = false;
-            size_t minDist = 0xffffffff;
-            for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
-                        fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
+            for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
+                        toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
             {
-              for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
-                          fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
+              for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
+                          toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
               {
-                for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
-                            toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
+                IVec2 from{int(fromX), int(fromY)};
+                IVec2 to{int(toX), int(toY)};
+                FrameArenaScope pathScope;
+                TilePath path = find_path_a_star(dd, from, to, limMin, limMax);
+                if (path.empty() && from != to)
                 {
-                  for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
-                              toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-                  {
-                    IVec2 from{int(fromX), int(fromY)};
-                    IVec2 to{int(toX), int(toY)};
-                    std::vector<IVec2> path = find_path_a_star(dd, from, to, limMin, limMax);
-                    if (path.empty() && from != to)
-                    {
-                      noPath = true; // if we found that there's no path at all - we can break out
-                      break;
-                    }
-                    minDist = std::min(minDist, path.size());
-                  }
+                  noPath = true; // if we found that there's no path at all - we can break out
+                  break;
                 }
+                minDist = std::min(minDist, path.size());
               }
             }
-            // write pathable data and length
-            if (noPath)
-              continue;
-            firstPortal.conns.push_back({indices[j], float(minDist)});
-            secondPortal.conns.push_back({indices[i], float(minDist)});
           }
         }
+        // write pathable data and length
+        if (noPath)
+          continue;
+        firstPortal.conns.push_back({indices[j], float(minDist)});
+        secondPortal.conns.push_back({indices[i], float(minDist)});
       }
-      e.set(DungeonPortals{splitTiles, portals, tilePortalsIndices});
+    }
+  }
+  return DungeonPortals{splitTiles, std::move(portals), std::move(tilePortalsIndices)};
+}
+
+void prebuild_map(flecs::world &ecs)
+{
+  PROFILE_SCOPE("prebuild_map");
+  auto mapQuery = ecs.query<const DungeonData>();
+
+  ecs.defer([&]()
+  {
+    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    {
+      e.set(build_portals(dd));
     });
   });
 }
 
 
-static std::vector<int> reconstruct_path(const std::vector<int>& prev, int to)
+static frame_vector<int> reconstruct_path(const frame_vector<int>& prev, int to)
 {
   int curPos = to;
-  std::vector<int> res = {curPos};
+  frame_vector<int> res;
+  res.push_back(curPos);
   while (prev[curPos] != -1)
   {
     curPos = prev[curPos];
@@ -254,11 +286,12 @@ static std::vector<int> reconstruct_path(const std::vector<int>& prev, int to)
 }
 
 
-static std::pair<std::vector<int>, float> find_path_portal_a_star(const DungeonPortals& dp, int from, int to)
+static std::pair<frame_vector<int>, float> find_path_portal_a_star(const DungeonPortals& dp, int from, int to)
 {
-  std::vector<float> g(dp.portals.size(), std::numeric_limits<float>::max());
-  std::vector<float> f(dp.portals.size(), std::numeric_limits<float>::max());
-  std::vector<int> prev(dp.portals.size(), -1);
+  TRACE_SCOPE("path_portal_a_star");
+  frame_vector<float> g(dp.portals.size(), std::numeric_limits<float>::max());
+  frame_vector<float> f(dp.portals.size(), std::numeric_limits<float>::max());
+  frame_vector<int> prev(dp.portals.size(), -1);
 
   auto getG = [&](int i) -> float { return g[i]; };
   auto getF = [&](int i) -> float { return f[i]; };
@@ -268,8 +301,9 @@ static std::pair<std::vector<int>, float> find_path_portal_a_star(const DungeonP
   g[from] = 0;
   f[from] = getH(from, to);
 
-  std::vector<int> openList = {from};
-  std::vector<int> closedList;
+  frame_vector<int> openList;
+  openList.push_back(from);
+  frame_vector<int> closedList;
 
   while (!openList.empty())
   {
@@ -308,12 +342,12 @@ static std::pair<std::vector<int>, float> find_path_portal_a_star(const DungeonP
     }
   }
   // empty path
-  return {std::vector<int>(), std::numeric_limits<float>::max()};
+  return {frame_vector<int>(), std::numeric_limits<float>::max()};
 }
 
 
 // in one supertile
-static std::vector<IVec2> find_path_tile_to_tile(const DungeonPortals &dp, const DungeonData &dd, const IVec2& tile_from, const IVec2& tile_to)
+static TilePath find_path_tile_to_tile(const DungeonPortals &dp, const DungeonData &dd, const IVec2& tile_from, const IVec2& tile_to)
 {
   auto splitTiles = dp.tileSplit;
   int from = (dd.width / dp.tileSplit) * (tile_from.y / dp.tileSplit) + (tile_from.x / dp.tileSplit);
@@ -324,13 +358,12 @@ static std::vector<IVec2> find_path_tile_to_tile(const DungeonPortals &dp, const
   IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
   IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
  
-  std::vector<IVec2> path = find_path_a_star(dd, tile_from, tile_to, limMin, limMax);
-  return path;
+  return find_path_a_star(dd, tile_from, tile_to, limMin, limMax);
 }
 
 
 // in one supertile
-static std::vector<IVec2> find_path_tile_to_portal(const DungeonPortals &dp, const DungeonData &dd, const IVec2& tile_from, int to)
+static TilePath find_path_tile_to_portal(const DungeonPortals &dp, const DungeonData &dd, const IVec2& tile_from, int to)
 {
   auto splitTiles = dp.tileSplit;
   int from = (dd.width / dp.tileSplit) * (tile_from.y / dp.tileSplit) + (tile_from.x / dp.tileSplit);
@@ -345,7 +378,7 @@ static std::vector<IVec2> find_path_tile_to_portal(const DungeonPortals &dp, con
 
   bool noPath = false;
   size_t minDist = 0xffffffff;
-  std::vector<IVec2> minPath;
+  TilePath minPath;
  
   for (size_t toY = std::max(portal.startY, size_t(limMin.y));
       toY <= std::min(portal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
@@ -354,7 +387,7 @@ static std::vector<IVec2> find_path_tile_to_portal(const DungeonPortals &dp, con
         toX <= std::min(portal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
     {
       IVec2 to{int(toX), int(toY)};
-      std::vector<IVec2> path = find_path_a_star(dd, tile_from, to, limMin, limMax);
+      TilePath path = find_path_a_star(dd, tile_from, to, limMin, limMax);
       if (path.empty() && tile_from != to)
       {
         noPath = true; // if we found that there's no path at all - we can break out
@@ -363,7 +396,7 @@ static std::vector<IVec2> find_path_tile_to_portal(const DungeonPortals &dp, con
       if (path.size() < minDist)
       {
         minDist = path.size();
-        minPath = path;
+        minPath = std::move(path);
       }
     }
   }
@@ -373,36 +406,48 @@ static std::vector<IVec2> find_path_tile_to_portal(const DungeonPortals &dp, con
 
 std::vector<Position> find_approximated_path(const DungeonPortals &dp, const DungeonData &dd, const Position& pos_from, const Position& pos_to)
 {
-  IVec2 tile_from = {pos_from.x / dungeon::tile_size, pos_from.y / dungeon::tile_size};
-  IVec2 tile_to = {pos_to.x / dungeon::tile_size, pos_to.y / dungeon::tile_size};
+  TRACE_SCOPE("path_query");
+  ALLOC_TAG_SCOPE(ALLOC_PATHFINDING);
+  // portals and tiles are in window coordinates, positions in and out are level ones
+  IVec2 tile_from = {int(pos_from.x / dungeon::tile_size) - dd.originX, int(pos_from.y / dungeon::tile_size) - dd.originY};
+  IVec2 tile_to = {int(pos_to.x / dungeon::tile_size) - dd.originX, int(pos_to.y / dungeon::tile_size) - dd.originY};
+  const IVec2 supertiles = {int(dd.width / dp.tileSplit), int(dd.height / dp.tileSplit)};
+  auto in_supertiles = [&](IVec2 t)
+  {
+    return t.x >= 0 && t.y >= 0 && t.x / int(dp.tileSplit) < supertiles.x && t.y / int(dp.tileSplit) < supertiles.y;
+  };
+  if (!in_supertiles(tile_from) || !in_supertiles(tile_to))
+    return std::vector<Position>();
+  const Position origin = {dd.originX * dungeon::tile_size, dd.originY * dungeon::tile_size};
   int from = (dd.width / dp.tileSplit) * (tile_from.y / dp.tileSplit) + (tile_from.x / dp.tileSplit);
   int to = (dd.width / dp.tileSplit) * (tile_to.y / dp.tileSplit) + (tile_to.x / dp.tileSplit);
 
-  auto tiles_to_pos = [&](const std::vector<IVec2>& a)
+  auto tiles_to_pos = [&](const TilePath& a)
   {
-    std::vector<Position> res;
+    frame_vector<Position> res;
     for (auto [x, y] : a)
     {
-      Position pos = {x * dungeon::tile_size, y * dungeon::tile_size};
+      Position pos = origin + Position{x * dungeon::tile_size, y * dungeon::tile_size};
       Position foot_pos = pos + Position{0.5f * dungeon::tile_size, 0.5f * dungeon::tile_size};
       res.push_back(foot_pos);
     }
     return res;
   };
 
-  auto portals_to_pos = [&](const std::vector<int>& a)
+  auto portals_to_pos = [&](const frame_vector<int>& a)
   {
-    std::vector<Position> res;
+    frame_vector<Position> res;
     for (auto& i : a)
     {
       const auto& p = dp.portals[i];
-      res.emplace_back((p.startX + p.endX + 1) / 2.0 * dungeon::tile_size, (p.startY + p.endY + 1) / 2.0 * dungeon::tile_size);
+      res.push_back(origin + Position{float((p.startX + p.endX + 1) / 2.0 * dungeon::tile_size),
+                                      float((p.startY + p.endY + 1) / 2.0 * dungeon::tile_size)});
     }
     return res;
   };
 
   float min_len = std::numeric_limits<float>::max();
-  std::vector<Position> min_path;
+  frame_vector<Position> min_path;
 
   if (to == from)
   {
@@ -438,12 +483,15 @@ std::vector<Position> find_approximated_path(const DungeonPortals &dp, const Dun
         path.insert(path.end(), mid_path.begin(), mid_path.end());
         std::reverse(end_path.begin(), end_path.end());
         path.insert(path.end(), end_path.begin(), end_path.end());
-        min_path = path;
+        min_path = std::move(path);
       }
     }
   }
+  if (min_path.empty())
+    return std::vector<Position>();
   min_path[0] = pos_from;
   min_path.back() = pos_to;
-  return min_path;
+  // the result is kept by callers past the frame, so it leaves the arena here
+  return std::vector<Position>(min_path.begin(), min_path.end());
 }
 
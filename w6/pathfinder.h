@@ -24,6 +24,8 @@ struct DungeonPortals
   std::vector<std::vector<size_t>> tilePortalsIndices;
 };
 
+// portal graph of the dungeon, doesn't touch the world so it can be built off the main thread
+DungeonPortals build_portals(const DungeonData &dd);
 void prebuild_map(flecs::world &ecs);
 std::vector<Position> find_approximated_path(const DungeonPortals &dp, const DungeonData &dd, const Position& pos_from, const Position& pos_to);
 
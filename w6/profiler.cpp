@@ -0,0 +1,364 @@
+#include "profiler.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <raylib.h>
+#include "chromeTrace.h"
+#include "allocTracker.h"
+
+namespace
+{
+  struct Sample
+  {
+    uint32_t id;
+    uint64_t duration;
+  };
+
+  // written by one thread, read by the main thread in end_frame
+  struct SampleRing
+  {
+    static constexpr size_t capacity = 1 << 12;
+    std::array<Sample, capacity> samples;
+    std::atomic<size_t> head = 0;
+    std::atomic<size_t> tail = 0;
+    std::atomic<size_t> dropped = 0;
+
+    void push(const Sample &s)
+    {
+      const size_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) == capacity)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      samples[h & (capacity - 1)] = s;
+      head.store(h + 1, std::memory_order_release);
+    }
+
+    template<typename Callable>
+    void drain(Callable c)
+    {
+      size_t t = tail.load(std::memory_order_relaxed);
+      const size_t h = head.load(std::memory_order_acquire);
+      for (; t != h; ++t)
+        c(samples[t & (capacity - 1)]);
+      tail.store(t, std::memory_order_release);
+    }
+  };
+
+  constexpr size_t max_threads = 64;
+  constexpr size_t max_entries = 512;
+
+  struct FrameStat
+  {
+    uint64_t ns = 0;
+    uint32_t calls = 0;
+  };
+
+  struct Entry
+  {
+    std::string name;
+    FrameStat current;
+    std::array<FrameStat, prof::history_frames> history{};
+  };
+
+  // A ring belongs to one thread at a time. Threads come and go with every ecs.reset(), so a
+  // thread that exits hands its slot back and the next new thread reuses the ring.
+  struct RingSlot
+  {
+    std::atomic<SampleRing*> ring = nullptr;
+    std::atomic<bool> taken = false;
+  };
+  std::array<RingSlot, max_threads> slots;
+
+  struct ThreadRing
+  {
+    SampleRing *ring = nullptr;
+    size_t slot = 0;
+    bool exhausted = false;
+
+    ~ThreadRing()
+    {
+      if (ring)
+        slots[slot].taken.store(false, std::memory_order_release);
+    }
+  };
+
+  std::mutex entriesMutex;
+  std::vector<std::unique_ptr<Entry>> entries;
+  std::unordered_map<std::string, uint32_t> entryIds;
+
+  size_t frameIdx = 0;
+  bool overlayEnabled = false;
+
+  // observers run while commands are merged, which can be on a worker thread
+  std::atomic<uint64_t> tableMoves = 0;
+  uint64_t lastFrameTableMoves = 0;
+
+  struct TableMove
+  {
+    ecs_entity_t entity = 0;
+    const ecs_table_t *from = nullptr;
+    const ecs_table_t *to = nullptr;
+  };
+  // a move emits an event for every component it adds or removes, the ones after the first repeat it
+  thread_local TableMove lastTableMove;
+
+  struct SystemEntry
+  {
+    uint32_t id;
+    const char *name; // points into Entry::name, which never moves
+  };
+
+  // systems of the current world, rebuilt by profile_systems and only read while they run
+  std::unordered_map<ecs_entity_t, SystemEntry> systemEntries;
+
+  SampleRing *thread_ring()
+  {
+    static thread_local ThreadRing owner;
+    if (owner.ring || owner.exhausted)
+      return owner.ring;
+    for (size_t i = 0; i < max_threads; ++i)
+    {
+      bool expected = false;
+      if (!slots[i].taken.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+        continue;
+      SampleRing *ring = slots[i].ring.load(std::memory_order_acquire);
+      if (!ring)
+      {
+        ring = new SampleRing;
+        slots[i].ring.store(ring, std::memory_order_release);
+      }
+      owner.ring = ring;
+      owner.slot = i;
+      return ring;
+    }
+    // more threads alive at once than slots, this one isn't profiled
+    owner.exhausted = true;
+    return nullptr;
+  }
+
+  void profiled_run(ecs_iter_t *it)
+  {
+    auto found = systemEntries.find(it->system);
+    const SystemEntry *entry = found != systemEntries.end() ? &found->second : nullptr;
+    TRACE_SCOPE(entry ? entry->name : "system");
+    // main thread already runs under the pipeline tag, workers start untagged
+    const AllocTag tag = alloc::current_tag();
+    ALLOC_TAG_SCOPE(tag == ALLOC_UNTAGGED ? ALLOC_WORKERS : tag);
+    const uint64_t start = prof::now_ns();
+    const ecs_iter_action_t action = it->callback;
+    while (ecs_iter_next(it))
+      action(it);
+    if (entry)
+      prof::record(entry->id, start, prof::now_ns());
+  }
+
+  std::string system_label(flecs::world &ecs, flecs::entity_t sys, size_t order)
+  {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "#%02d ", int(order));
+    if (const char *name = ecs_get_name(ecs.c_ptr(), sys))
+      return prefix + std::string(name);
+    // anonymous systems are told apart by registration order and signature
+    std::string label = prefix;
+    if (char *sig = ecs_query_str(ecs_system_get_query(ecs.c_ptr(), sys)))
+    {
+      label += sig;
+      ecs_os_free(sig);
+    }
+    return label;
+  }
+
+  void stats(const Entry &e, double &avg_us, double &p99_us, double &calls)
+  {
+    const size_t frames = std::min(frameIdx, prof::history_frames);
+    if (frames == 0)
+    {
+      avg_us = p99_us = calls = 0.0;
+      return;
+    }
+    std::array<uint64_t, prof::history_frames> ns;
+    uint64_t sum = 0;
+    uint64_t callSum = 0;
+    for (size_t i = 0; i < frames; ++i)
+    {
+      ns[i] = e.history[i].ns;
+      sum += ns[i];
+      callSum += e.history[i].calls;
+    }
+    const size_t p99 = std::min(frames - 1, size_t(frames * 0.99));
+    std::nth_element(ns.begin(), ns.begin() + p99, ns.begin() + frames);
+    avg_us = sum / double(frames) * 1e-3;
+    p99_us = ns[p99] * 1e-3;
+    calls = callSum / double(frames);
+  }
+}
+
+uint64_t prof::now_ns()
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t prof::register_entry(const char *name)
+{
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  auto found = entryIds.find(name);
+  if (found != entryIds.end())
+    return found->second;
+  if (entries.size() == max_entries)
+    return uint32_t(max_entries - 1);
+  const uint32_t id = uint32_t(entries.size());
+  entries.push_back(std::make_unique<Entry>());
+  entries.back()->name = name;
+  entryIds.emplace(name, id);
+  return id;
+}
+
+void prof::record(uint32_t id, uint64_t start_ns, uint64_t end_ns)
+{
+  if (SampleRing *ring = thread_ring())
+    ring->push(Sample{id, end_ns - start_ns});
+}
+
+void prof::profile_systems(flecs::world &ecs)
+{
+  std::vector<flecs::entity_t> systems;
+  ecs.each(flecs::System, [&](flecs::entity sys) { systems.push_back(sys); });
+  systemEntries.clear();
+  for (size_t i = 0; i < systems.size(); ++i)
+  {
+    const uint32_t id = register_entry(system_label(ecs, systems[i], i).c_str());
+    {
+      std::lock_guard<std::mutex> lock(entriesMutex);
+      systemEntries[systems[i]] = SystemEntry{id, entries[id]->name.c_str()};
+    }
+    // updating an existing system only replaces the fields that are set
+    ecs_system_desc_t desc = {};
+    desc.entity = systems[i];
+    desc.run = profiled_run;
+    ecs_system_init(ecs.c_ptr(), &desc);
+  }
+}
+
+void prof::count_table_moves(flecs::world &ecs)
+{
+  ecs.observer()
+    .event(flecs::OnAdd)
+    .event(flecs::OnRemove)
+    .term(flecs::Wildcard)
+    .iter([](flecs::iter &it)
+    {
+      // OnAdd fires in the table the entity moved to, OnRemove in the one it's leaving
+      const ecs_iter_t *c = it.c_ptr();
+      const bool added = c->event == flecs::OnAdd;
+      const ecs_table_t *from = added ? c->other_table : c->table;
+      const ecs_table_t *to = added ? c->table : c->other_table;
+      uint64_t moves = 0;
+      for (auto i : it)
+      {
+        const ecs_entity_t e = it.entity(i).id();
+        if (e == lastTableMove.entity && from == lastTableMove.from && to == lastTableMove.to)
+          continue;
+        lastTableMove = TableMove{e, from, to};
+        ++moves;
+      }
+      tableMoves.fetch_add(moves, std::memory_order_relaxed);
+    });
+}
+
+uint64_t prof::table_moves_last_frame()
+{
+  return lastFrameTableMoves;
+}
+
+void prof::end_frame()
+{
+  lastFrameTableMoves = tableMoves.exchange(0, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  for (RingSlot &slot : slots)
+    if (SampleRing *ring = slot.ring.load(std::memory_order_acquire))
+      ring->drain([&](const Sample &s)
+      {
+        FrameStat &cur = entries[s.id]->current;
+        cur.ns += s.duration;
+        cur.calls++;
+      });
+  const size_t slot = frameIdx % history_frames;
+  for (std::unique_ptr<Entry> &e : entries)
+  {
+    e->history[slot] = e->current;
+    e->current = FrameStat{};
+  }
+  frameIdx++;
+}
+
+void prof::handle_keys()
+{
+  if (IsKeyPressed(KEY_F3))
+    overlayEnabled = !overlayEnabled;
+  if (IsKeyPressed(KEY_F4))
+    dump_csv("profile.csv");
+}
+
+void prof::draw_overlay(int x, int y)
+{
+  if (!overlayEnabled)
+    return;
+  struct Row { const Entry *entry; double avg, p99, calls; };
+  std::vector<Row> rows;
+  {
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    for (const std::unique_ptr<Entry> &e : entries)
+    {
+      Row row{e.get(), 0.0, 0.0, 0.0};
+      stats(*e, row.avg, row.p99, row.calls);
+      rows.push_back(row);
+    }
+  }
+  std::sort(rows.begin(), rows.end(), [](const Row &lhs, const Row &rhs) { return lhs.avg > rhs.avg; });
+  constexpr int fontSize = 16;
+  constexpr int maxRows = 40;
+  const int shown = std::min(int(rows.size()), maxRows);
+  DrawRectangle(x - 4, y - 4, 900, (shown + 2) * (fontSize + 2) + 8, Fade(BLACK, 0.7f));
+  DrawText(TextFormat("%-10s %-10s %-8s %s", "avg us", "p99 us", "calls", "entry"), x, y, fontSize, YELLOW);
+  for (int i = 0; i < shown; ++i)
+  {
+    const Row &r = rows[i];
+    DrawText(TextFormat("%-10.1f %-10.1f %-8.1f %s", r.avg, r.p99, r.calls, r.entry->name.c_str()),
+             x, y + (i + 1) * (fontSize + 2), fontSize, WHITE);
+  }
+  DrawText(TextFormat("table moves last frame: %llu", (unsigned long long)lastFrameTableMoves),
+           x, y + (shown + 1) * (fontSize + 2), fontSize, YELLOW);
+}
+
+bool prof::dump_csv(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  std::lock_guard<std::mutex> lock(entriesMutex);
+  fprintf(f, "frame,entry,calls,us\n");
+  const size_t frames = std::min(frameIdx, history_frames);
+  for (size_t i = 0; i < frames; ++i)
+  {
+    const size_t frame = frameIdx - frames + i;
+    for (const std::unique_ptr<Entry> &e : entries)
+    {
+      const FrameStat &st = e->history[frame % history_frames];
+      if (st.calls == 0)
+        continue;
+      fprintf(f, "%zu,\"%s\",%u,%.3f\n", frame, e->name.c_str(), st.calls, st.ns * 1e-3);
+    }
+  }
+  fclose(f);
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <flecs.h>
+
+// Frame profiler for systems and the phases running outside of them. Every thread pushes its
+// samples into its own single producer ring, the main thread drains all rings in end_frame and
+// keeps a rolling window of per frame totals for each entry. State is global, so entries and
+// history survive ecs.reset() on level up.
+namespace prof
+{
+  constexpr size_t history_frames = 240;
+
+  uint64_t now_ns();
+  // returns the same id for the same name
+  uint32_t register_entry(const char *name);
+  void record(uint32_t id, uint64_t start_ns, uint64_t end_ns);
+
+  struct ScopeTimer
+  {
+    uint32_t id;
+    uint64_t start;
+
+    explicit ScopeTimer(uint32_t entry_id) : id(entry_id), start(now_ns()) {}
+    ~ScopeTimer() { record(id, start, now_ns()); }
+  };
+
+  // wraps the run callback of every system in the world, call after all systems are registered
+  void profile_systems(flecs::world &ecs);
+
+  // Counts entities moving to another table. A move that adds or removes several components, like a
+  // merged batch of deferred commands or creating an entity from a prefab, counts once; destroying
+  // an entity counts as a move out of its table. Call once per world, after the level is built so
+  // spawning the level isn't counted.
+  void count_table_moves(flecs::world &ecs);
+  // of the last finished frame
+  uint64_t table_moves_last_frame();
+
+  void end_frame();
+  // F3 toggles the overlay, F4 dumps the history to profile.csv
+  void handle_keys();
+  void draw_overlay(int x, int y);
+  bool dump_csv(const char *path);
+}
+
+#define PROF_CONCAT_IMPL(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) \
+  static const uint32_t PROF_CONCAT(profEntry, __LINE__) = prof::register_entry(name); \
+  const prof::ScopeTimer PROF_CONCAT(profScope, __LINE__)(PROF_CONCAT(profEntry, __LINE__))
@@ -1,12 +1,16 @@
 #include "rlikeObjects.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include "steering.h"
+#include "behaviourTree.h"
+#include "blackboard.h"
 
 flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const char *texture_src)
 {
   flecs::entity textureSrc = ecs.entity(texture_src);
   return ecs.entity()
     .set(Position{pos.x, pos.y})
+    .set(PrevPosition{pos.x, pos.y})
     .set(Velocity{0.f, 0.f})
     .set(MoveSpeed{0.9f * dungeon::tile_size})
     .set(Hitpoints{100.f})
@@ -24,6 +28,7 @@ void create_player(flecs::world &ecs, Position pos, const char *texture_src)
   flecs::entity textureSrc = ecs.entity(texture_src);
   ecs.entity("player")
     .set(Position{pos.x, pos.y})
+    .set(PrevPosition{pos.x, pos.y})
     .set(Velocity{0.f, 0.f})
     .set(MoveSpeed{3 * dungeon::tile_size})
     .set(Hitpoints{100.f})
@@ -39,3 +44,71 @@ void create_player(flecs::world &ecs, Position pos, const char *texture_src)
 
 }
 
+
+void register_monster_prefabs(flecs::world &ecs, const Color *colors, int count, const char *texture_src)
+{
+  flecs::entity textureSrc = ecs.entity(texture_src);
+  MonsterPool pool;
+  for (int type = 0; type < count; ++type)
+  {
+    // every component is overridden, instances own their data and land in one table per archetype
+    flecs::entity prefab = ecs.prefab()
+      .set_override(Position{0.f, 0.f})
+      .set_override(PrevPosition{0.f, 0.f})
+      .set_override(Velocity{0.f, 0.f})
+      .set_override(MoveSpeed{0.9f * dungeon::tile_size})
+      .set_override(Hitpoints{100.f})
+      .set_override(Action{EA_NOP})
+      .set_override(Color{colors[type]})
+      .override<TextureSource>(textureSrc)
+      .set_override(Team{1})
+      .set_override(NumActions{1, 0})
+      .set_override(MeleeDamage{10.f})
+      .set_override(MeleeDist{2 * dungeon::tile_size})
+      .set_override(PooledMonster{type});
+    steer::create_steerer_prefab(prefab);
+    pool.prefabs.push_back(prefab);
+  }
+  pool.free.resize(pool.prefabs.size());
+  ecs.set<MonsterPool>(pool);
+}
+
+flecs::entity acquire_monster(flecs::world &ecs, int type, Position pos, bool &fresh)
+{
+  MonsterPool &pool = *ecs.get_mut<MonsterPool>();
+  std::vector<flecs::entity_t> &freeList = pool.free[type];
+  fresh = freeList.empty();
+  if (fresh)
+    return ecs.entity()
+      .is_a(pool.prefabs[type])
+      .set(Position{pos.x, pos.y})
+      .set(PrevPosition{pos.x, pos.y});
+
+  flecs::entity e(ecs, freeList.back());
+  freeList.pop_back();
+  // enable() moves the entity out of the Disabled table again, but nothing is constructed: only
+  // the per life state is reset, the behaviour tree and blackboard are kept and cleared
+  e.enable()
+    .set(Position{pos.x, pos.y})
+    .set(PrevPosition{pos.x, pos.y})
+    .set(Velocity{0.f, 0.f})
+    .set(Hitpoints{100.f})
+    .set(Action{EA_NOP})
+    .set(NumActions{1, 0});
+  if (BehaviourTree *bt = e.get_mut<BehaviourTree>())
+    bt->reset();
+  if (Blackboard *bb = e.get_mut<Blackboard>())
+    bb->reset();
+  return e;
+}
+
+bool release_monster(flecs::world &ecs, flecs::entity e)
+{
+  const PooledMonster *pooled = e.get<PooledMonster>();
+  if (!pooled)
+    return false;
+  steer::reset_steerer(e);
+  e.disable();
+  ecs.get_mut<MonsterPool>()->free[pooled->type].push_back(e);
+  return true;
+}
@@ -2,10 +2,31 @@
 #include <flecs.h>
 #include "raylib.h"
 #include "ecsTypes.h"
+#include <vector>
 
 flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const char *texture_src);
 void create_player(flecs::world &ecs, Position pos, const char *texture_src);
 
+// Spawners instantiate monsters from one prefab per archetype. Dead monsters are disabled and
+// kept here with their behaviour tree and blackboard, the next spawn of the same type reuses them.
+// Disabling and enabling still move the entity between tables, the pool saves the allocations.
+struct MonsterPool
+{
+  std::vector<flecs::entity_t> prefabs;
+  std::vector<std::vector<flecs::entity_t>> free; // per prefab
+};
+
+struct PooledMonster
+{
+  int type;
+};
+
+void register_monster_prefabs(flecs::world &ecs, const Color *colors, int count, const char *texture_src);
+// fresh is set when the entity was just instantiated, its behaviour has to be built then
+flecs::entity acquire_monster(flecs::world &ecs, int type, Position pos, bool &fresh);
+// disables a pooled monster, returns false if e didn't come from the pool
+bool release_monster(flecs::world &ecs, flecs::entity e);
+
 struct MonsterSpawner
 {
   float timeToSpawn;
@@ -1,168 +1,190 @@
 #include <algorithm>
-#include <memory>
 #include <raylib.h>
 #include "shootEmUp.h"
 #include "ecsTypes.h"
 #include "rlikeObjects.h"
 #include "steering.h"
-#include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
 #include "math.h"
 #include "blackboard.h"
 #include "aiLibrary.h"
 #include "pathfinder.h"
+#include "fixedStep.h"
+#include "tileMap.h"
+#include "spriteBatch.h"
+#include "culling.h"
+#include "tileCollision.h"
+#include "debugDraw.h"
+#include "gameInput.h"
+#include "gameRandom.h"
+#include "worldRegistry.h"
+#include "profiler.h"
+#include "chromeTrace.h"
+#include "allocTracker.h"
+#include "levelGen.h"
 
 using dungeon::tile_size;
 
 static void register_roguelike_systems(flecs::world &ecs)
 {
-  static auto playerPosQuery = ecs.query<const Position, const IsPlayer>();
-
-  ecs.system<Velocity, const MoveSpeed, const Position, const IsPlayer>()
-    .each([&](Velocity &vel, const MoveSpeed &ms, const Position pos, const IsPlayer)
+  register_pipelines(ecs);
+#ifndef HEADLESS
+  ecs.set<SpriteBatch>({});
+  // sprites are anchored at their top left corner and hp bars stick out above them
+  register_culling(ecs, dungeon::tile_size);
+  register_debug_draw(ecs);
+#endif
+
+  ecs.system<Velocity, const MoveSpeed, const IsPlayer>()
+    .each([&](Velocity &vel, const MoveSpeed &ms, const IsPlayer)
     {
-      bool left = IsKeyDown(KEY_LEFT);
-      bool right = IsKeyDown(KEY_RIGHT);
-      bool up = IsKeyDown(KEY_UP);
-      bool down = IsKeyDown(KEY_DOWN);
-      float dt = ecs.delta_time();
-      Position up_left_hit = pos + Position{0.15f * dungeon::tile_size, 0.75f * dungeon::tile_size};
-      Position up_right_hit = pos + Position{0.75f * dungeon::tile_size, 0.75f * dungeon::tile_size};
-      Position down_left_hit = pos + Position{0.15f * dungeon::tile_size, 0.95f * dungeon::tile_size};
-      Position down_right_hit = pos + Position{0.75f * dungeon::tile_size, 0.95f * dungeon::tile_size};
+      bool left = game_key_down(KEY_LEFT);
+      bool right = game_key_down(KEY_RIGHT);
+      bool up = game_key_down(KEY_UP);
+      bool down = game_key_down(KEY_DOWN);
       float vx = ((left ? -1 : 0) + (right ? 1 : 0));
-      Position delta = Position{vx * ms.speed, 0.0f} * dt;
-      if (vx > 0.f)
-      {
-        if (!dungeon::is_tile_walkable(ecs, up_right_hit + delta) || !dungeon::is_tile_walkable(ecs, down_right_hit + delta))
-        {
-          vx = -0.01f;
-        }
-      }
-      else if (vx < 0.f)
-      {
-        if (!dungeon::is_tile_walkable(ecs, up_left_hit + delta) || !dungeon::is_tile_walkable(ecs, down_left_hit + delta))
-        {
-          vx = 0.01f;
-        }
-      }
       float vy = ((up ? -1 : 0) + (down ? 1 : 0));
-      delta = Position{0.0f, vy * ms.speed} * dt;
-      if (vy > 0.f)
-      {
-        if (!dungeon::is_tile_walkable(ecs, down_left_hit + delta) || !dungeon::is_tile_walkable(ecs, down_right_hit + delta))
-        {
-          vy = -0.01f;
-        }
-      }
-      else
-      {
-        if (!dungeon::is_tile_walkable(ecs, up_left_hit + delta) || !dungeon::is_tile_walkable(ecs, up_right_hit + delta))
-        {
-          vy = 0.01f;
-        }
-      }
       vel = Velocity{normalize(Velocity{vx, vy}) * ms.speed};
     });
-  ecs.system<Position, const Velocity>()
-    .each([&](Position &pos, const Velocity &vel)
+  // collision stage: every moving entity is swept against the walkable bit grid
+  ecs.system<Position, Velocity>()
+    .multi_threaded()
+    .each([](flecs::iter &it, size_t, Position &pos, Velocity &vel)
     {
-      pos += vel * ecs.delta_time();
+      const WalkableGrid *grid = it.world().get<WalkableGrid>();
+      if (grid)
+        dungeon::move_and_collide(*grid, pos, vel, it.delta_time());
+      else
+        pos += vel * it.delta_time();
     });
   ecs.system<Position, const IsPlayer>()
     .each([&](Position &pos, const IsPlayer)
     {
-      Position exit_pos = *ecs.lookup("exit").get<Position>() + Position{dungeon::tile_size / 2, dungeon::tile_size / 2};
+      Position exit_pos = *registry(ecs).exit.get<Position>() + Position{dungeon::tile_size / 2, dungeon::tile_size / 2};
       Position foot_pos = pos + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
       if (dist(exit_pos, foot_pos) <= dungeon::tile_size / 2)
       {
         ecs.quit();
       }
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+#ifndef HEADLESS
+  ecs.system<const TileMap>()
+    .kind(flecs::OnStore)
+    .each([&](const TileMap &tileMap)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x) * dungeon::tile_size, float(pos.y) * dungeon::tile_size, dungeon::tile_size, dungeon::tile_size}, color);
+      for (const TileMap::Chunk &chunk : tileMap.chunks)
+        if (cull_test(ecs, Position{chunk.bounds.x, chunk.bounds.y},
+                      Position{chunk.bounds.x + chunk.bounds.width, chunk.bounds.y + chunk.bounds.height}))
+          draw_tile_chunk(chunk);
     });
   ecs.system<const Position, const Color>()
     .term<TextureSource>(flecs::Wildcard).not_()
+    .kind(flecs::OnStore)
     .each([&](const Position &pos, const Color color)
     {
       const Rectangle rect = {float(pos.x) * dungeon::tile_size, float(pos.y) * dungeon::tile_size, dungeon::tile_size, dungeon::tile_size};
-      DrawRectangleRec(rect, color);
+      if (cull_test(ecs, Position{rect.x, rect.y}, Position{rect.x + rect.width, rect.y + rect.height}))
+        DrawRectangleRec(rect, color);
     });
   ecs.system<const Position, const DungeonExit>()
+    .kind(flecs::OnStore)
     .each([&](const Position &pos, const DungeonExit)
     {
+      if (!cull_test(ecs, pos, pos + Position{dungeon::tile_size, dungeon::tile_size}))
+        return;
       DrawCircle(pos.x + dungeon::tile_size / 2, pos.y + dungeon::tile_size / 2, dungeon::tile_size / 2, RAYWHITE);
       for (int i = 1; i <= 3; ++i)
       {
-        float r = int(ecs.get_info()->world_time_total * dungeon::tile_size / i) % int(dungeon::tile_size / 2);
+        float r = int(GetTime() * dungeon::tile_size / i) % int(dungeon::tile_size / 2);
         DrawCircleLines(pos.x + dungeon::tile_size / 2, pos.y + dungeon::tile_size / 2, dungeon::tile_size / 2 - r, BLACK);
       }
     });
   ecs.system<const Position, const MonsterSpawner>()
+    .kind(flecs::OnStore)
     .each([&](const Position &pos, const MonsterSpawner&)
     {
+      if (!cull_test(ecs, pos, pos + Position{dungeon::tile_size, dungeon::tile_size}))
+        return;
       DrawCircle(pos.x + dungeon::tile_size / 2, pos.y + dungeon::tile_size / 2, dungeon::tile_size / 2, BLACK);
       for (int i = 1; i <= 3; ++i)
       {
-        float r = int(ecs.get_info()->world_time_total * dungeon::tile_size / i) % int(dungeon::tile_size / 2);
+        float r = int(GetTime() * dungeon::tile_size / i) % int(dungeon::tile_size / 2);
         DrawCircleLines(pos.x + dungeon::tile_size / 2, pos.y + dungeon::tile_size / 2, r, WHITE);
       }
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>().not_()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+  // sprites and hp bars only go through the moving entities the culling stage found on screen
+  ecs.system<const VisibleSet>()
+    .kind(flecs::OnStore)
+    .each([&](const VisibleSet &visible)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x), float(pos.y), dungeon::tile_size, dungeon::tile_size}, color);
+      for (flecs::entity_t id : visible.entities)
+      {
+        const flecs::entity e(ecs, id);
+        if (!e.is_alive())
+          continue;
+        const Position *simPos = e.get<Position>();
+        const Color *color = e.get<Color>();
+        const auto textureSrc = e.target<TextureSource>();
+        if (!simPos || !color || !textureSrc)
+          continue;
+        const Position pos = render_position(e, *simPos);
+        ecs.get_mut<SpriteBatch>()->push(sprite_layer_characters, *textureSrc.get<SpriteRegion>(),
+            Rectangle{float(pos.x), float(pos.y), dungeon::tile_size, dungeon::tile_size}, *color);
+      }
     });
-  ecs.system<const Position, const Hitpoints>()
-    .each([&](const Position &pos, const Hitpoints &hp)
+  // everything pushed to the batch above is drawn here, sorted by layer and atlas page
+  ecs.system<SpriteBatch>()
+    .kind(flecs::OnStore)
+    .each([](SpriteBatch &batch)
     {
-      constexpr float hpPadding = 0.05f;
-      const float hpWidth = 1.f - 2.f * hpPadding;
-      const Rectangle underRect = {pos.x + hpPadding * dungeon::tile_size, pos.y - 0.25 * dungeon::tile_size,
-                                   hpWidth * dungeon::tile_size, 0.1f * dungeon::tile_size};
-      DrawRectangleRec(underRect, BLACK);
-      const Rectangle hpRect = {pos.x + hpPadding * dungeon::tile_size, pos.y - 0.25 * dungeon::tile_size,
-                                hp.hitpoints / 100.f * hpWidth * dungeon::tile_size, 0.1f * dungeon::tile_size};
-      DrawRectangleRec(hpRect, RED);
+      batch.flush(get_sprite_atlas());
     });
-
-  ecs.system<Texture2D>()
-    .each([&](Texture2D &tex)
+  ecs.system<const VisibleSet>()
+    .kind(flecs::OnStore)
+    .each([&](const VisibleSet &visible)
     {
-      SetTextureFilter(tex, TEXTURE_FILTER_POINT);
+      for (flecs::entity_t id : visible.entities)
+      {
+        const flecs::entity e(ecs, id);
+        if (!e.is_alive())
+          continue;
+        const Position *simPos = e.get<Position>();
+        const Hitpoints *hp = e.get<Hitpoints>();
+        if (!simPos || !hp)
+          continue;
+        const Position pos = render_position(e, *simPos);
+        constexpr float hpPadding = 0.05f;
+        const float hpWidth = 1.f - 2.f * hpPadding;
+        const Rectangle underRect = {pos.x + hpPadding * dungeon::tile_size, pos.y - 0.25 * dungeon::tile_size,
+                                     hpWidth * dungeon::tile_size, 0.1f * dungeon::tile_size};
+        DrawRectangleRec(underRect, BLACK);
+        const Rectangle hpRect = {pos.x + hpPadding * dungeon::tile_size, pos.y - 0.25 * dungeon::tile_size,
+                                  hp->hitpoints / 100.f * hpWidth * dungeon::tile_size, 0.1f * dungeon::tile_size};
+        DrawRectangleRec(hpRect, RED);
+      }
     });
 
+#endif
   ecs.system<MonsterSpawner, const Position>()
-    .each([&](MonsterSpawner &ms, const Position& pos)
+    .each([&](flecs::iter &it, size_t, MonsterSpawner &ms, const Position& pos)
     {
       //playerPosQuery.each([&](const Position &pp, const IsPlayer &)
       {
-        ms.timeToSpawn -= ecs.delta_time();
+        ms.timeToSpawn -= it.delta_time();
         while (ms.timeToSpawn < 0.f)
         {
-          int v = GetRandomValue(0, steer::Type::Num - 1);
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
+          int v = game_random(0, steer::Type::Num - 1);
           //const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
           //const float dist = distances[st];
           //constexpr int angRandMax = 1 << 16;
           //const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
-          Color col = colors[v];
 
-          flecs::entity e = steer::create_steerer(create_monster(ecs, pos, col, "minotaur_tex"));
+          bool fresh = false;
+          flecs::entity e = acquire_monster(ecs, v, pos, fresh);
+          ms.timeToSpawn += ms.timeBetweenSpawns;
+          if (!fresh)
+            continue; // recycled monster still has its blackboard and behaviour tree
           e.set(Blackboard{});
           BehNode *root =
             utility_selector({
@@ -187,177 +209,283 @@ static void register_roguelike_systems(flecs::world &ecs)
             });
           e.add<WorldInfoGatherer>();
           e.set(BehaviourTree{root});
-
-          ms.timeToSpawn += ms.timeBetweenSpawns;
         }
       }
     });
 
-  static auto cameraQuery = ecs.query<const Camera2D>();
+#ifndef HEADLESS
   ecs.system<const DungeonPortals, const DungeonData>()
+    .kind(flecs::OnStore)
     .each([&](const DungeonPortals &dp, const DungeonData &dd)
     {
-      size_t w = dd.width;
-      size_t ts = dp.tileSplit;
-      for (size_t y = 0; y < dd.height / ts; ++y)
-        DrawLineEx(Vector2{0.f, y * ts * tile_size},
-                   Vector2{dd.width * tile_size, y * ts * tile_size}, 1.f, GetColor(0xff000080));
-      for (size_t x = 0; x < dd.width / ts; ++x)
-        DrawLineEx(Vector2{x * ts * tile_size, 0.f},
-                   Vector2{x * ts * tile_size, dd.height * tile_size}, 1.f, GetColor(0xff000080));
-      /*cameraQuery*/ecs.each([&](Camera2D cam)
+      if (!debug_channel_enabled(DEBUG_PORTALS))
+        return;
+      registry(ecs).cameras.each([&](Camera2D &cam)
       {
+        // portals are in window tiles, the overlay is drawn relative to the window origin
+        const Position origin{dd.originX * tile_size, dd.originY * tile_size};
         Vector2 mousePosition = GetScreenToWorld2D(GetMousePosition(), cam);
-        size_t wd = w / ts;
-        for (size_t y = 0; y < dd.height / ts; ++y)
+        mousePosition.x -= origin.x;
+        mousePosition.y -= origin.y;
+        // portals are tile aligned, hover highlight only changes with the hovered tile
+        uint64_t key = debug_key_combine(0, uint64_t(int64_t(floorf(mousePosition.x / tile_size))));
+        key = debug_key_combine(key, uint64_t(int64_t(floorf(mousePosition.y / tile_size))));
+        key = debug_key_combine(key, uint64_t(dd.originX));
+        key = debug_key_combine(key, uint64_t(dd.originY));
+        // a window clamped to the level edge keeps its origin when it grows
+        key = debug_key_combine(key, dd.width);
+        key = debug_key_combine(key, dd.height);
+        debug_draw(ecs, DEBUG_PORTALS, key, [&](DebugRecorder &rec)
         {
-          if (mousePosition.y < y * ts * tile_size || mousePosition.y > (y + 1) * ts * tile_size)
-            continue;
+          rec.offset = origin;
+          size_t w = dd.width;
+          size_t ts = dp.tileSplit;
+          for (size_t y = 0; y < dd.height / ts; ++y)
+            rec.line(Position{0.f, y * ts * tile_size},
+                     Position{dd.width * tile_size, y * ts * tile_size}, 1.f, GetColor(0xff000080));
           for (size_t x = 0; x < dd.width / ts; ++x)
+            rec.line(Position{x * ts * tile_size, 0.f},
+                     Position{x * ts * tile_size, dd.height * tile_size}, 1.f, GetColor(0xff000080));
+          size_t wd = w / ts;
+          for (size_t y = 0; y < dd.height / ts; ++y)
           {
-            if (mousePosition.x < x * ts * tile_size || mousePosition.x > (x + 1) * ts * tile_size)
+            if (mousePosition.y < y * ts * tile_size || mousePosition.y > (y + 1) * ts * tile_size)
               continue;
-            for (size_t idx : dp.tilePortalsIndices[y * wd + x])
+            for (size_t x = 0; x < dd.width / ts; ++x)
             {
-              const PathPortal &portal = dp.portals[idx];
-              Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
-                             (portal.endX - portal.startX + 1) * tile_size,
-                             (portal.endY - portal.startY + 1) * tile_size};
-              DrawRectangleLinesEx(rect, 3, BLACK);
+              if (mousePosition.x < x * ts * tile_size || mousePosition.x > (x + 1) * ts * tile_size)
+                continue;
+              for (size_t idx : dp.tilePortalsIndices[y * wd + x])
+              {
+                const PathPortal &portal = dp.portals[idx];
+                Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
+                               (portal.endX - portal.startX + 1) * tile_size,
+                               (portal.endY - portal.startY + 1) * tile_size};
+                rec.rect_lines(rect, 3, BLACK);
+              }
             }
           }
-        }
-        for (const PathPortal &portal : dp.portals)
-        {
-          Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
-                         (portal.endX - portal.startX + 1) * tile_size,
-                         (portal.endY - portal.startY + 1) * tile_size};
-          Vector2 fromCenter{rect.x + rect.width * 0.5f, rect.y + rect.height * 0.5f};
-          DrawRectangleLinesEx(rect, 1, WHITE);
-          if (mousePosition.x < rect.x || mousePosition.x > rect.x + rect.width ||
-              mousePosition.y < rect.y || mousePosition.y > rect.y + rect.height)
-            continue;
-          DrawRectangleLinesEx(rect, 4, WHITE);
-          for (const PortalConnection &conn : portal.conns)
+          for (const PathPortal &portal : dp.portals)
           {
-            const PathPortal &endPortal = dp.portals[conn.connIdx];
-            Vector2 toCenter{(endPortal.startX + endPortal.endX + 1) * tile_size * 0.5f,
-                             (endPortal.startY + endPortal.endY + 1) * tile_size * 0.5f};
-            DrawLineEx(fromCenter, toCenter, 1.f, WHITE);
-            DrawText(TextFormat("%d", int(conn.score)),
-                     (fromCenter.x + toCenter.x) * 0.5f,
-                     (fromCenter.y + toCenter.y) * 0.5f,
-                     16, WHITE);
+            Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
+                           (portal.endX - portal.startX + 1) * tile_size,
+                           (portal.endY - portal.startY + 1) * tile_size};
+            Position fromCenter{rect.x + rect.width * 0.5f, rect.y + rect.height * 0.5f};
+            rec.rect_lines(rect, 1, WHITE);
+            if (mousePosition.x < rect.x || mousePosition.x > rect.x + rect.width ||
+                mousePosition.y < rect.y || mousePosition.y > rect.y + rect.height)
+              continue;
+            rec.rect_lines(rect, 4, WHITE);
+            for (const PortalConnection &conn : portal.conns)
+            {
+              const PathPortal &endPortal = dp.portals[conn.connIdx];
+              Position toCenter{(endPortal.startX + endPortal.endX + 1) * tile_size * 0.5f,
+                                (endPortal.startY + endPortal.endY + 1) * tile_size * 0.5f};
+              rec.line(fromCenter, toCenter, 1.f, WHITE);
+              rec.text(TextFormat("%d", int(conn.score)), (fromCenter + toCenter) * 0.5f, 16, WHITE);
+            }
           }
-        }
+        });
       });
     });
 
     ecs.system<const DungeonPortals, const DungeonData>()
+    .kind(flecs::OnStore)
     .each([&](const DungeonPortals &dp, const DungeonData &dd)
     {
-      auto p = ecs.lookup("player");
-      if (p != 0 && p.is_alive())
+      if (!debug_channel_enabled(DEBUG_EXIT_PATH))
+        return;
+      const WorldRegistry &reg = registry(ecs);
+      flecs::entity p = reg.player;
+      if (p.is_alive() && p.has<Position>())
       {
-        Position exit_pos = *ecs.lookup("exit").get<Position>() + Position{dungeon::tile_size / 2, dungeon::tile_size / 2};
+        Position exit_pos = *reg.exit.get<Position>() + Position{dungeon::tile_size / 2, dungeon::tile_size / 2};
         Position foot_pos = *p.get<Position>() + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
-        auto path = find_approximated_path(dp, dd, foot_pos, exit_pos);
-        for (int i = 0; i + 1 < path.size(); ++i)
+        // path is only searched again once the player steps onto another tile or the window moves,
+        // the search runs over the portals of the current window
+        uint64_t key = debug_key_combine(0, uint64_t(int64_t(floorf(foot_pos.x / tile_size))));
+        key = debug_key_combine(key, uint64_t(int64_t(floorf(foot_pos.y / tile_size))));
+        key = debug_key_combine(key, uint64_t(int64_t(floorf(exit_pos.x / tile_size))));
+        key = debug_key_combine(key, uint64_t(int64_t(floorf(exit_pos.y / tile_size))));
+        key = debug_key_combine(key, uint64_t(dd.originX));
+        key = debug_key_combine(key, uint64_t(dd.originY));
+        // a window clamped to the level edge keeps its origin when it grows
+        key = debug_key_combine(key, dd.width);
+        key = debug_key_combine(key, dd.height);
+        debug_draw(ecs, DEBUG_EXIT_PATH, key, [&](DebugRecorder &rec)
         {
-          auto [x1, y1] = path[i];
-          auto [x2, y2] = path[i + 1];
-          DrawLineEx(Vector2{x1, y1}, Vector2{x2, y2}, 5.f, RED);
-          DrawText(TextFormat("%d", int(path.size()) - i - 1), x1, y1, 16, WHITE);
-        }
-        DrawText(TextFormat("%d", 0), path.back().x, path.back().y, 16, WHITE);
+          auto path = find_approximated_path(dp, dd, foot_pos, exit_pos);
+          for (int i = 0; i + 1 < path.size(); ++i)
+          {
+            rec.line(path[i], path[i + 1], 5.f, RED);
+            rec.text(TextFormat("%d", int(path.size()) - i - 1), path[i], 16, WHITE);
+          }
+          if (!path.empty())
+            rec.text(TextFormat("%d", 0), path.back(), 16, WHITE);
+        });
       }
     });
+#endif
   steer::register_systems(ecs);
 }
 
 
-static void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+// headless runs have no GL context to load the atlas into, entities only serve as TextureSource targets
+static flecs::entity create_texture_entity(flecs::world &ecs, const char *name, const char *region)
+{
+#ifdef HEADLESS
+  (void)region;
+  return ecs.entity(name);
+#else
+  return ecs.entity(name)
+    .set(get_sprite_atlas().get(region));
+#endif
+}
+
+
+// Monsters and spawners off the window have no tiles or dmaps to act on, so they're disabled until a
+// window covers them again instead of sitting in the systems half updated. Asleep keeps them apart
+// from the pooled monsters, which are disabled as well.
+static void sleep_outside_window(flecs::world &ecs)
 {
-  flecs::entity wallTex = ecs.entity("wall_tex")
-    .set(Texture2D{LoadTexture("assets/wall.png")});
-  flecs::entity floorTex = ecs.entity("floor_tex")
-    .set(Texture2D{LoadTexture("assets/floor.png")});
-
-  std::vector<char> dungeonData;
-  dungeonData.resize(w * h);
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-      dungeonData[y * w + x] = tiles[y * w + x];
-  ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
-
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
+  PROFILE_SCOPE("sleep_outside_window");
+  const WorldRegistry &reg = registry(ecs);
+  const DungeonData &dd = *reg.dungeon.get<DungeonData>();
+  ecs.defer([&]
+  {
+    auto sleep_outside = [&](flecs::entity e, const Position &pos)
     {
-      char tile = tiles[y * w + x];
-      flecs::entity tileEntity = ecs.entity()
-        .add<BackgroundTile>()
-        .set(Position{int(x), int(y)})
-        .set(Color{255, 255, 255, 255});
-      if (tile == dungeon::wall)
-        tileEntity.add<TextureSource>(wallTex);
-      else if (tile == dungeon::floor)
-        tileEntity.add<TextureSource>(floorTex);
-    }
-    prebuild_map(ecs);
-    printf("+++++++++++++++++++++++++++++++++++\n");
-  
-    dungeon::is_tile_walkable(ecs, Position{0,0}); // init static query, only allowed when app is not in progress
-    printf("+++++++++++++++++++++++++++++++++++\n");
+      if (!dungeon::is_in_window(dd, pos))
+        e.add<Asleep>().disable();
+    };
+    reg.monsters.each(sleep_outside);
+    reg.spawners.each([&](flecs::entity e, const Position &pos, const MonsterSpawner &)
+    {
+      sleep_outside(e, pos);
+    });
+    reg.sleepers.each([&](flecs::entity e, const Position &pos)
+    {
+      if (dungeon::is_in_window(dd, pos))
+        e.remove<Asleep>().enable();
+    });
+  });
+}
+
+static_assert(TileMap::chunk_size == ChunkedDungeon::chunk_size, "a window has to cover whole tile map chunks");
+
+// baking the tile map needs the GL context, so it's the one part of a window left to the main thread.
+// The first window is baked whole, later ones only queue the chunks they add.
+static void set_dungeon_window(flecs::world &ecs, DungeonWindow &window)
+{
+  const WorldRegistry &reg = registry(ecs);
+#ifndef HEADLESS
+  const DungeonData &dd = window.dungeon;
+  if (ecs.has<TileMap>())
+    update_tile_map(*ecs.get_mut<TileMap>(), dd.tiles.data(), dd.width, dd.height, dd.originX, dd.originY,
+                    dungeon::tile_size);
+  else
+    set_tile_map(ecs, bake_tile_map(dd.tiles.data(), dd.width, dd.height, dd.originX, dd.originY,
+                                    dungeon::tile_size, get_sprite_atlas(),
+                                    *reg.wallTex.get<SpriteRegion>(), *reg.floorTex.get<SpriteRegion>()));
+#endif
+  ecs.set<WalkableGrid>(std::move(window.walkable));
+  reg.dungeon
+    .set(std::move(window.dungeon))
+    .set(std::move(window.portals));
+  DungeonStreaming *streaming = ecs.get_mut<DungeonStreaming>();
+  streaming->centreX = window.centreX;
+  streaming->centreY = window.centreY;
+  sleep_outside_window(ecs);
+}
 
+// asks for a new window once the player leaves the chunk the current window is centred on and swaps
+// in windows the streamer has finished
+static void update_dungeon_window(flecs::world &ecs)
+{
+  PROFILE_SCOPE("update_dungeon_window");
+  if (!ecs.has<DungeonStreaming>())
+    return;
+  const DungeonStreaming &streaming = *ecs.get<DungeonStreaming>();
+  DungeonStreamer *streamer = streaming.streamer;
+  registry(ecs).players.each([&](const Position &pos, const IsPlayer &)
+  {
+    const int cx = int(pos.x / dungeon::tile_size) / int(ChunkedDungeon::chunk_size);
+    const int cy = int(pos.y / dungeon::tile_size) / int(ChunkedDungeon::chunk_size);
+    if (cx != streaming.centreX || cy != streaming.centreY)
+      streamer->request(cx, cy);
+  });
+#ifdef HEADLESS
+  // the step a window arrives at decides sleeping and spawning, seeded runs have to replay exactly
+  constexpr bool waitForWindow = true;
+#else
+  constexpr bool waitForWindow = false;
+#endif
+  DungeonWindow window;
+  if (streamer->poll(window, waitForWindow))
+    set_dungeon_window(ecs, window);
+#ifndef HEADLESS
+  // one chunk per step, a window move adds a row or a column of chunks, all of them a chunk away from the player
+  if (TileMap *tileMap = ecs.get_mut<TileMap>(); tileMap && !tileMap->pending.empty())
+  {
+    const WorldRegistry &reg = registry(ecs);
+    bake_pending_chunks(*tileMap, 1, get_sprite_atlas(),
+                        *reg.wallTex.get<SpriteRegion>(), *reg.floorTex.get<SpriteRegion>());
+  }
+#endif
 }
 
 
-void init_shoot_em_up(flecs::world &ecs, size_t w, size_t h, size_t spawn_cnt)
+void init_shoot_em_up(flecs::world &ecs, size_t w, size_t h, size_t spawn_cnt, DungeonStreamer &streamer)
 {
-  std::unique_ptr<char[]> tiles(new char[w * h]);
-  gen_drunk_dungeon(tiles.get(), w, h);
-  init_dungeon(ecs, tiles.get(), w, h);
+  init_shoot_em_up(ecs, build_level_layout(w, h, spawn_cnt, game_random_seed()), streamer);
+}
+
+void init_shoot_em_up(flecs::world &ecs, LevelLayout layout, DungeonStreamer &streamer)
+{
+  ALLOC_TAG_SCOPE(ALLOC_LEVEL_INIT);
+  init_world_registry(ecs);
+  create_texture_entity(ecs, "wall_tex", "wall");
+  create_texture_entity(ecs, "floor_tex", "floor");
+  streamer.reset(std::move(layout.store));
+  ecs.set(DungeonStreaming{&streamer, layout.window.centreX, layout.window.centreY});
 
   register_roguelike_systems(ecs);
 
-  ecs.entity("swordsman_tex")
-    .set(Texture2D{LoadTexture("assets/swordsman.png")});
-  ecs.entity("minotaur_tex")
-    .set(Texture2D{LoadTexture("assets/minotaur.png")});
+  create_texture_entity(ecs, "swordsman_tex", "swordsman");
+  create_texture_entity(ecs, "minotaur_tex", "minotaur");
+  const Color monsterColors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
+  register_monster_prefabs(ecs, monsterColors, steer::Type::Num, "minotaur_tex");
 
   //steer::create_seeker(create_monster(ecs, {+400, +400}, WHITE, "minotaur_tex"));
   //steer::create_pursuer(create_monster(ecs, {-400, +400}, RED, "minotaur_tex"));
   //steer::create_evader(create_monster(ecs, {-400, -400}, BLUE, "minotaur_tex"));
   //steer::create_fleer(create_monster(ecs, {+400, -400}, GREEN, "minotaur_tex"));
 
-  Position player_pos = dungeon::find_walkable_tile(ecs);
-  create_player(ecs, player_pos, "swordsman_tex");
+  create_player(ecs, layout.playerPos, "swordsman_tex");
 
-  std::vector<float> dm;
-  dmaps::gen_player_approach_map(ecs, dm);
-  int n = std::ranges::max_element(dm, {}, [](float v){ return v == 1e5 ? 0 : v; }) - dm.begin();
-  int i = n / w;
-  int j = n % w;
-
-  Position exit_pos = {j * dungeon::tile_size, i * dungeon::tile_size};
   ecs.entity("exit")
     .add<DungeonExit>()
-    .set(Position{exit_pos});
-
-  std::vector<Position> obj_pos = {player_pos, exit_pos};
-  for (int k = 0; k < spawn_cnt; ++k)
-  {
-    dmaps::gen_multiobject_approach_map(ecs, obj_pos, dm);
-    int n = std::ranges::max_element(dm, {}, [](float v){ return v == 1e5 ? 0 : v; }) - dm.begin();
-    int i = n / w;
-    int j = n % w;
-    Position spawn_pos = {j * dungeon::tile_size, i * dungeon::tile_size};
-    obj_pos.push_back(spawn_pos);
+    .set(Position{layout.exitPos});
+
+  // filled by the first process_game
+  const WorldRegistry &reg = registry(ecs);
+  reg.approachMap
+    .set(DijkstraMapData{})
+    .set(FlowFieldData{});
+  reg.fleeMap
+    .set(DijkstraMapData{})
+    .set(FlowFieldData{});
+  ecs.set(PlayerDmapSources{});
+
+  for (const Position &spawn_pos : layout.spawnerPos)
     ecs.entity()
       .set(MonsterSpawner{0.f, 10.0f})
       .set(Position{spawn_pos});
-  }
+  set_dungeon_window(ecs, layout.window);
+
+  // every system of this world is registered by now
+  prof::profile_systems(ecs);
+  prof::count_table_moves(ecs);
 }
 
 
@@ -388,34 +516,36 @@ static bool is_reachable(flecs::world &ecs, const Position& a, const Position& b
 }
 
 
-static void process_actions(flecs::world &ecs)
+static void process_actions(flecs::world &ecs, float dt)
 {
-  static auto processActions = ecs.query<const Position, const MeleeDamage, const MeleeDist, const Team>();
-  static auto checkAttacks = ecs.query<const Position, Hitpoints, const Team>();
+  PROFILE_SCOPE("process_actions");
+  const WorldRegistry &reg = registry(ecs);
   ecs.defer([&]
   {
-    /*processActions*/ecs.each([&](flecs::entity entity, const Position &pos, const MeleeDamage &dmg, const MeleeDist& hit_dist, const Team &team)
+    reg.attackers.each([&](flecs::entity entity, const Position &pos, const MeleeDamage &dmg, const MeleeDist& hit_dist, const Team &team)
     {
-      /*checkAttacks*/ecs.each([&](flecs::entity enemy, const Position& enemy_pos, Hitpoints &hp, const Team &enemy_team)
+      reg.attackTargets.each([&](flecs::entity enemy, const Position& enemy_pos, Hitpoints &hp, const Team &enemy_team)
       {
         if (team.team != enemy_team.team && dist_sq(pos, enemy_pos) <= sqr(hit_dist.dist) && is_reachable(ecs, pos, enemy_pos))
         {
           //push_to_log(ecs, "damaged entity");
-          hp.hitpoints -= dmg.damage * ecs.delta_time();
+          hp.hitpoints -= dmg.damage * dt;
         }
       });
     });
   });
 
-  static auto deleteAllDead = ecs.query<const Hitpoints>();
-  ecs.defer([&]
+  static std::vector<flecs::entity> dead;
+  dead.clear();
+  reg.hitpoints.each([&](flecs::entity entity, const Hitpoints &hp)
   {
-    /*deleteAllDead*/ecs.each([&](flecs::entity entity, const Hitpoints &hp)
-    {
-      if (hp.hitpoints <= 0.f)
-        entity.destruct();
-    });
+    if (hp.hitpoints <= 0.f)
+      dead.push_back(entity);
   });
+  // pooled monsters go back to the spawner pool, everything else is destroyed
+  for (flecs::entity entity : dead)
+    if (!release_monster(ecs, entity))
+      entity.destruct();
 }
 
 
@@ -429,19 +559,17 @@ static void push_info_to_bb(Blackboard &bb, const char *name, const T &val)
 
 static void gather_world_info(flecs::world &ecs)
 {
-  static auto gatherWorldInfo = ecs.query<Blackboard,
-                                          const Position, const Hitpoints,
-                                          const WorldInfoGatherer,
-                                          const Team>();
-  static auto alliesQuery = ecs.query<const Position, const Team>();
-  /*gatherWorldInfo*/ecs.each([&](Blackboard &bb, const Position &pos, const Hitpoints &hp,
+  PROFILE_SCOPE("gather_world_info");
+  ALLOC_TAG_SCOPE(ALLOC_AI);
+  const WorldRegistry &reg = registry(ecs);
+  reg.worldInfoGatherers.each([&](Blackboard &bb, const Position &pos, const Hitpoints &hp,
                            WorldInfoGatherer, const Team &team)
   {
     // first gather all needed names (without cache)
     push_info_to_bb(bb, "hp", hp.hitpoints);
     float numAllies = 0; // note float
     float closestEnemyDist = 100.f;
-    /*alliesQuery*/ecs.each([&](const Position &apos, const Team &ateam)
+    reg.teamPositions.each([&](const Position &apos, const Team &ateam)
     {
       constexpr float limitDist = 4.f * dungeon::tile_size;
       if (team.team == ateam.team && dist_sq(pos, apos) < sqr(limitDist))
@@ -455,8 +583,8 @@ static void gather_world_info(flecs::world &ecs)
     });
     push_info_to_bb(bb, "alliesNum", numAllies);
     push_info_to_bb(bb, "enemyDist", closestEnemyDist);
-    auto player = ecs.lookup("player");
-    if (player != 0 && player.is_alive())
+    flecs::entity player = reg.player;
+    if (player.is_alive())
     {
       push_info_to_bb(bb, "flee_enemy", player);
       push_info_to_bb(bb, "approach_enemy", player);
@@ -465,10 +593,50 @@ static void gather_world_info(flecs::world &ecs)
 }
 
 
-void process_game(flecs::world &ecs)
+// Approach and flee maps of the player with their flow fields. They're rebuilt in place, so the
+// vectors keep their capacity, and only when a player tile or the window differs from the last build.
+static void update_player_dmaps(flecs::world &ecs)
+{
+  PROFILE_SCOPE("update_player_dmaps");
+  const WorldRegistry &reg = registry(ecs);
+  const DungeonData &dd = *reg.dungeon.get<DungeonData>();
+  PlayerDmapSources &sources = *ecs.get_mut<PlayerDmapSources>();
+  sources.positions.clear();
+  sources.tiles.clear();
+  reg.teamPositions.each([&](const Position &pos, const Team &t)
+  {
+    if (t.team != 0) // player team hardcode
+      return;
+    sources.positions.push_back(pos);
+    sources.tiles.push_back(dmaps::source_tile(pos));
+  });
+  const bool sameWindow = sources.originX == dd.originX && sources.originY == dd.originY &&
+                          sources.width == dd.width && sources.height == dd.height;
+  if (sources.built && sameWindow && sources.tiles == sources.builtTiles)
+    return;
+  std::swap(sources.tiles, sources.builtTiles);
+  sources.originX = dd.originX;
+  sources.originY = dd.originY;
+  sources.width = dd.width;
+  sources.height = dd.height;
+  sources.built = true;
+
+  DijkstraMapData &approachMap = *reg.approachMap.get_mut<DijkstraMapData>();
+  DijkstraMapData &fleeMap = *reg.fleeMap.get_mut<DijkstraMapData>();
+  dmaps::gen_multiobject_approach_map(dd, sources.positions, approachMap.map);
+  dmaps::gen_flow_field(dd, approachMap.map, *reg.approachMap.get_mut<FlowFieldData>());
+  dmaps::gen_player_flee_map(dd, approachMap.map, fleeMap.map);
+  dmaps::gen_flow_field(dd, fleeMap.map, *reg.fleeMap.get_mut<FlowFieldData>());
+}
+
+
+void process_game(flecs::world &ecs, float dt)
 {
+  PROFILE_SCOPE("process_game");
+  ALLOC_TAG_SCOPE(ALLOC_SIMULATION);
+  update_dungeon_window(ecs);
   //static auto stateMachineAct = ecs.query<StateMachine>();
-  static auto behTreeUpdate = ecs.query<BehaviourTree, Blackboard>();
+  const WorldRegistry &reg = registry(ecs);
   //static auto turnIncrementer = ecs.query<TurnCounter>();
   //if (is_player_acted(ecs))
   {
@@ -478,36 +646,24 @@ void process_game(flecs::world &ecs)
       gather_world_info(ecs);
       ecs.defer([&]
       {
+        ALLOC_TAG_SCOPE(ALLOC_AI);
         /*stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
         {
           sm.act(0.f, ecs, e);
         });*/
-        /*behTreeUpdate*/ecs.each([&](flecs::entity e, BehaviourTree &bt, Blackboard &bb)
+        reg.behaviourTrees.each([&](flecs::entity e, BehaviourTree &bt, Blackboard &bb)
         {
+          TRACE_SCOPE_ARG("bt_update", "entity", e.id());
           bt.update(ecs, e, bb);
         });
         //process_dmap_followers(ecs);
       });
       //turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
-    process_actions(ecs);
-
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
-
-    /*std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+    process_actions(ecs, dt);
+    update_player_dmaps(ecs);
 
-    //ecs.entity("flee_map").add<VisualiseMap>();
+    /*//ecs.entity("flee_map").add<VisualiseMap>();
     ecs.entity("hive_follower_sum")
       .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
       .add<VisualiseMap>();*/
@@ -1,7 +1,12 @@
 #pragma once
 #include <flecs.h>
+#include "levelGen.h"
 
 //void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
-void init_shoot_em_up(flecs::world &ecs, size_t w, size_t h, size_t spawn_cnt);
-void process_game(flecs::world &ecs);
+// builds the layout right away, on the calling thread
+void init_shoot_em_up(flecs::world &ecs, size_t w, size_t h, size_t spawn_cnt, DungeonStreamer &streamer);
+// the level's chunk store is handed over to the streamer, which keeps its window around the player
+void init_shoot_em_up(flecs::world &ecs, LevelLayout layout, DungeonStreamer &streamer);
+// one simulation tick of the game logic outside the flecs pipeline, passed to the fixed step loop
+void process_game(flecs::world &ecs, float dt);
 
@@ -0,0 +1,39 @@
+#include "spatialGrid.h"
+
+void rebuild_spatial_grid(flecs::world &ecs, SpatialGrid &grid)
+{
+  grid.unsorted.clear();
+  Position minPos{0.f, 0.f};
+  Position maxPos{0.f, 0.f};
+  ecs.each([&](flecs::entity e, const Position &pos, const Velocity &vel)
+  {
+    if (grid.unsorted.empty())
+      minPos = maxPos = pos;
+    minPos = Position{std::min(minPos.x, pos.x), std::min(minPos.y, pos.y)};
+    maxPos = Position{std::max(maxPos.x, pos.x), std::max(maxPos.y, pos.y)};
+    grid.unsorted.push_back({e.id(), pos, vel});
+  });
+
+  grid.origin = minPos;
+  grid.width = int((maxPos.x - minPos.x) / grid.cellSize) + 1;
+  grid.height = int((maxPos.y - minPos.y) / grid.cellSize) + 1;
+  const size_t numCells = size_t(grid.width) * size_t(grid.height);
+
+  // counting sort by cell
+  grid.cellStart.assign(numCells + 1, 0);
+  auto cellOf = [&](const Position &pos)
+  {
+    return size_t(grid.cell_y(pos.y)) * size_t(grid.width) + size_t(grid.cell_x(pos.x));
+  };
+  for (const SpatialGrid::Item &item : grid.unsorted)
+    grid.cellStart[cellOf(item.pos) + 1]++;
+  for (size_t i = 1; i <= numCells; ++i)
+    grid.cellStart[i] += grid.cellStart[i - 1];
+  grid.items.resize(grid.unsorted.size());
+  for (const SpatialGrid::Item &item : grid.unsorted)
+    grid.items[grid.cellStart[cellOf(item.pos)]++] = item;
+  // scattering moved every start to the start of the next cell
+  for (size_t i = numCells; i > 0; --i)
+    grid.cellStart[i] = grid.cellStart[i - 1];
+  grid.cellStart[0] = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// Uniform grid of moving entities, rebuilt from scratch every frame.
+// Items are sorted by cell, so every cell is a contiguous range in items.
+struct SpatialGrid
+{
+  struct Item
+  {
+    flecs::entity_t entity = 0;
+    Position pos;
+    Velocity vel;
+  };
+
+  float cellSize = 500.f; // the largest query radius (cohesion)
+  Position origin;
+  int width = 0;
+  int height = 0;
+  std::vector<uint32_t> cellStart; // width * height + 1 offsets
+  std::vector<Item> items;
+  std::vector<Item> unsorted;
+
+  int cell_x(float x) const { return std::clamp(int((x - origin.x) / cellSize), 0, width - 1); }
+  int cell_y(float y) const { return std::clamp(int((y - origin.y) / cellSize), 0, height - 1); }
+
+  // calls c for every item not farther than radius from p, including the asking entity
+  template<typename Callable>
+  void each_in_radius(const Position &p, float radius, Callable c) const
+  {
+    if (items.empty())
+      return;
+    const float radiusSq = radius * radius;
+    const int maxX = cell_x(p.x + radius);
+    const int maxY = cell_y(p.y + radius);
+    for (int y = cell_y(p.y - radius); y <= maxY; ++y)
+      for (int x = cell_x(p.x - radius); x <= maxX; ++x)
+      {
+        const size_t cell = size_t(y) * size_t(width) + size_t(x);
+        for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+          if (length_sq(items[i].pos - p) <= radiusSq)
+            c(items[i]);
+      }
+  }
+
+  // calls c for every item inside the [lo, hi] box
+  template<typename Callable>
+  void each_in_rect(const Position &lo, const Position &hi, Callable c) const
+  {
+    if (items.empty())
+      return;
+    const int maxX = cell_x(hi.x);
+    const int maxY = cell_y(hi.y);
+    for (int y = cell_y(lo.y); y <= maxY; ++y)
+      for (int x = cell_x(lo.x); x <= maxX; ++x)
+      {
+        const size_t cell = size_t(y) * size_t(width) + size_t(x);
+        for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+        {
+          const Position &p = items[i].pos;
+          if (p.x >= lo.x && p.x <= hi.x && p.y >= lo.y && p.y <= hi.y)
+            c(items[i]);
+        }
+      }
+  }
+};
+
+void rebuild_spatial_grid(flecs::world &ecs, SpatialGrid &grid);
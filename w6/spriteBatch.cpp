@@ -0,0 +1,14 @@
+#include "spriteBatch.h"
+#include <algorithm>
+
+void SpriteBatch::flush(const SpriteAtlas &atlas)
+{
+  // stable, so sprites on the same layer and page keep their submission order
+  std::stable_sort(sprites.begin(), sprites.end(), [](const Sprite &a, const Sprite &b)
+  {
+    return a.layer != b.layer ? a.layer < b.layer : a.page < b.page;
+  });
+  for (const Sprite &sprite : sprites)
+    DrawTexturePro(atlas.pages[sprite.page], sprite.src, sprite.dst, Vector2{0.f, 0.f}, 0.f, sprite.tint);
+  sprites.clear();
+}
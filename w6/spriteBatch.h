@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <raylib.h>
+#include "spriteAtlas.h"
+
+constexpr int sprite_layer_characters = 0;
+
+// Sprites collected over a frame and drawn sorted by layer and atlas page, so every page
+// is bound once per layer and raylib merges the quads into a single draw call.
+struct SpriteBatch
+{
+  struct Sprite
+  {
+    int layer;
+    int page;
+    Rectangle src;
+    Rectangle dst;
+    Color tint;
+  };
+  std::vector<Sprite> sprites;
+
+  void push(int layer, const SpriteRegion &region, const Rectangle &dst, Color tint)
+  {
+    sprites.push_back({layer, region.page, region.rect, dst, tint});
+  }
+  void flush(const SpriteAtlas &atlas);
+};
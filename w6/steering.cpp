@@ -1,6 +1,10 @@
 #include "steering.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include "spatialGrid.h"
+#include "steerSoA.h"
+#include "orca.h"
+#include "worldRegistry.h"
 
 struct SteerAccel { float accel = 1.f; };
 
@@ -23,14 +27,37 @@ flecs::entity steer::create_steerer(flecs::entity e)
 {
   return //create_cohesion(
       create_alignment(
-        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
+        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}).set(SteerMode{}))
         //)
       );
 }
 
+flecs::entity steer::create_steerer_prefab(flecs::entity prefab)
+{
+  return prefab
+    .set_override(SteerDir{0.f, 0.f})
+    .set_override(SteerAccel{1.f})
+    .set_override(SteerMode{})
+    .override<Separation>()
+    .override<Alignment>();
+}
+
+void steer::reset_steerer(flecs::entity e)
+{
+  e.set(SteerDir{0.f, 0.f});
+  set_steer_mode(e, SteerNone);
+}
+
+void steer::set_steer_mode(flecs::entity e, SteerModeType mode)
+{
+  const SteerMode *sm = e.get<SteerMode>();
+  if (!sm || sm->mode != mode)
+    e.set(SteerMode{mode});
+}
+
 flecs::entity steer::create_seeker(flecs::entity e)
 {
-  return create_steerer(e).add<Seeker>();
+  return create_steerer(e).set(SteerMode{SteerSeek});
 }
 
 flecs::entity steer::create_pursuer(flecs::entity e)
@@ -45,7 +72,53 @@ flecs::entity steer::create_evader(flecs::entity e)
 
 flecs::entity steer::create_fleer(flecs::entity e)
 {
-  return create_steerer(e).add<Fleer>();
+  return create_steerer(e).set(SteerMode{SteerFlee});
+}
+
+// Read-only copies of what steering needs from outside the agent itself, taken once per frame
+// before the worker threads start, so parallel systems never run nested queries.
+struct SteerSnapshot
+{
+  Position playerPos;
+  Velocity playerVel;
+  bool hasPlayer = false;
+  const FlowFieldData *approachFlow = nullptr;
+  const FlowFieldData *fleeFlow = nullptr;
+};
+
+// every worker mirrors the chunk of agents it was handed into its own arrays
+static SteerSoA &gather_chunk(flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms,
+                              SteerDir *sd, const SteerAccel *sa)
+{
+  static thread_local SteerSoA soa;
+  soa.clear();
+  for (auto i : it)
+    soa.push(pos[i], vel[i], ms[i].speed, sa[i].accel, sd[i]);
+  return soa;
+}
+
+// unit move per Actions index of a flow field
+static const Position flowDirs[EA_MOVE_END] =
+{
+  {0.f, 0.f},  // EA_NOP
+  {-1.f, 0.f}, // EA_MOVE_LEFT
+  {1.f, 0.f},  // EA_MOVE_RIGHT
+  {0.f, 1.f},  // EA_MOVE_DOWN
+  {0.f, -1.f}  // EA_MOVE_UP
+};
+
+// steers towards the neighbour tile the flow field points at
+static SteerDir follow_flow(const FlowFieldData &flow, const MoveSpeed &ms, const Velocity &vel, const Position &pos)
+{
+  const Position foot_pos = pos + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
+  const int x = int(foot_pos.x / dungeon::tile_size) - flow.originX;
+  const int y = int(foot_pos.y / dungeon::tile_size) - flow.originY;
+  if (x < 0 || y < 0 || size_t(x) >= flow.width || size_t(y) >= flow.height)
+    return SteerDir{0.f, 0.f};
+  const uint8_t dir = flow.dirs[size_t(y) * flow.width + size_t(x)];
+  if (dir == EA_NOP)
+    return SteerDir{0.f, 0.f};
+  return SteerDir{(flowDirs[dir] * ms.speed - vel) * 1.1f};
 }
 
 typedef flecs::entity (*create_foo)(flecs::entity);
@@ -65,262 +138,171 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
 
 void steer::register_systems(flecs::world &ecs)
 {
-  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
-
-  ecs.system<Velocity, const MoveSpeed, const SteerDir, const SteerAccel, const Position>()
-    .each([&](Velocity &vel, const MoveSpeed &ms, const SteerDir &sd, const SteerAccel &sa, const Position& pos)
+  // Systems marked multi_threaded are split between flecs worker threads. They only touch
+  // their own agent's components and read shared data from the snapshot or the grid.
+  ecs.set<SteerSnapshot>({});
+  ecs.system<SteerSnapshot>()
+    .each([&](SteerSnapshot &snap)
     {
-      vel = Velocity{truncate(vel + truncate(sd, ms.speed) * ecs.delta_time() * sa.accel, ms.speed)};
-      float dt = ecs.delta_time();
-      Position up_left_hit = pos + Position{0.15f * dungeon::tile_size, 0.75f * dungeon::tile_size};
-      Position up_right_hit = pos + Position{0.75f * dungeon::tile_size, 0.75f * dungeon::tile_size};
-      Position down_left_hit = pos + Position{0.15f * dungeon::tile_size, 0.95f * dungeon::tile_size};
-      Position down_right_hit = pos + Position{0.75f * dungeon::tile_size, 0.95f * dungeon::tile_size};
-      float vx = vel.x;
-      Position delta = Position{vx, 0.0f} * dt;
-      if (vx > 0.f)
+      snap = SteerSnapshot{};
+      const WorldRegistry &reg = registry(ecs);
+      reg.playerMotion.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
       {
-        if (!dungeon::is_tile_walkable(ecs, up_right_hit + delta) || !dungeon::is_tile_walkable(ecs, down_right_hit + delta))
-        {
-          vx = -1.f;
-        }
-      }
-      else if (vx < 0.f)
-      {
-        if (!dungeon::is_tile_walkable(ecs, up_left_hit + delta) || !dungeon::is_tile_walkable(ecs, down_left_hit + delta))
-        {
-          vx = 1.f;
-        }
-      }
-      float vy = vel.y;
-      delta = Position{0.0f, vy} * dt;
-      if (vy > 0.f)
-      {
-        if (!dungeon::is_tile_walkable(ecs, down_left_hit + delta) || !dungeon::is_tile_walkable(ecs, down_right_hit + delta))
-        {
-          vy = -1.f;
-        }
-      }
-      else
-      {
-        if (!dungeon::is_tile_walkable(ecs, up_left_hit + delta) || !dungeon::is_tile_walkable(ecs, up_right_hit + delta))
-        {
-          vy = 1.f;
-        }
-      }
-      vel = {vx, vy};
+        snap.playerPos = pp;
+        snap.playerVel = pvel;
+        snap.hasPlayer = true;
+      });
+      snap.approachFlow = reg.approachMap.get<FlowFieldData>();
+      snap.fleeFlow = reg.fleeMap.get<FlowFieldData>();
     });
 
-  // reset steer dir
-  ecs.system<SteerDir>().each([&](SteerDir &sd) { sd = {0.f, 0.f}; });
-
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
-  // seeker
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Seeker>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel,
-              const Position &pos, const Seeker &)
+  // steering state is mirrored into SoA arrays so kernels process several agents at once
+  ecs.system<const Position, Velocity, const MoveSpeed, SteerDir, const SteerAccel>()
+    .multi_threaded()
+    .iter([](flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms, SteerDir *sd, const SteerAccel *sa)
     {
-      /*
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
-      {
-        sd += SteerDir{normalize(pp - pos) * ms.speed - vel};
-      });
-      */
-      
-      auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y)
-      {
-        return dmap.map[y * dd.width + x];
-      };
-      auto get_vec = [&](Actions a)
-      {
-        switch (a)
-        {
-          case EA_NOP: return Position{0,0};
-          case EA_MOVE_LEFT: return Position{-1,0};
-          case EA_MOVE_RIGHT: return Position{1,0};
-          case EA_MOVE_UP: return Position{0,-1};
-          case EA_MOVE_DOWN: return Position{0,1};
-        }
-      };
-      auto get_pos = [&](const Position pos) -> std::pair<int, int>
-      {
-        Position foot_pos = pos + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
-        return {foot_pos.x / dungeon::tile_size, foot_pos.y / dungeon::tile_size};
-      };
-      /*dungeonDataQuery*/ecs.each([&](const DungeonData &dd)
-      {
-        float moveWeights[EA_MOVE_END];
-        for (size_t i = 0; i < EA_MOVE_END; ++i)
-          moveWeights[i] = 0.f;
-        ecs.entity("approach_map").get([&](const DijkstraMapData &dmap)
-        {
-          auto [x, y] = get_pos(pos);
-          moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, x+0, y+0);
-          moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, x-1, y+0);
-          moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, x+1, y+0);
-          moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, x+0, y-1);
-          moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, x+0, y+1);
-        });
-        float minWt = moveWeights[EA_NOP];
-        SteerDir dsd;
-        for (size_t i = 0; i < EA_MOVE_END; ++i)
-          if (moveWeights[i] < minWt)
-          {
-            minWt = moveWeights[i];
-            dsd = SteerDir{get_vec(Actions(i)) * ms.speed - vel};
-          }
-        sd = {dsd.x * 1.1, dsd.y * 1.1};
-      });
+      SteerSoA &soa = gather_chunk(it, pos, vel, ms, sd, sa);
+      steer::batch_integrate_velocity(soa, 0, soa.size(), it.delta_time());
+      soa.write_back(0, soa.size());
     });
 
-  // fleer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Fleer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &pos, const Fleer &)
+  // reset steer dir
+  ecs.system<SteerDir>().multi_threaded().each([](SteerDir &sd) { sd = {0.f, 0.f}; });
+
+  // seekers follow the approach field and fleers the flee field, picked by value
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const SteerMode>()
+    .multi_threaded()
+    .each([](flecs::iter &it, size_t, SteerDir &sd, const MoveSpeed &ms, const Velocity &vel,
+              const Position &pos, const SteerMode &sm)
     {
-      /*
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
-      {
-        sd += SteerDir{normalize(pos - pp) * ms.speed - vel};
-      });
-      */
-      
-      auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y)
-      {
-        return dmap.map[y * dd.width + x];
-      };
-      auto get_vec = [&](Actions a)
-      {
-        switch (a)
-        {
-          case EA_NOP: return Position{0,0};
-          case EA_MOVE_LEFT: return Position{-1,0};
-          case EA_MOVE_RIGHT: return Position{1,0};
-          case EA_MOVE_UP: return Position{0,-1};
-          case EA_MOVE_DOWN: return Position{0,1};
-        }
-      };
-      auto get_pos = [&](const Position pos) -> std::pair<int, int>
-      {
-        Position foot_pos = pos + Position{0.45f * dungeon::tile_size, 0.85f * dungeon::tile_size};
-        return {foot_pos.x / dungeon::tile_size, foot_pos.y / dungeon::tile_size};
-      };
-      /*dungeonDataQuery*/ecs.each([&](const DungeonData &dd)
-      {
-        float moveWeights[EA_MOVE_END];
-        for (size_t i = 0; i < EA_MOVE_END; ++i)
-          moveWeights[i] = 0.f;
-        ecs.entity("flee_map").get([&](const DijkstraMapData &dmap)
-        {
-          auto [x, y] = get_pos(pos);
-          moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, x+0, y+0);
-          moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, x-1, y+0);
-          moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, x+1, y+0);
-          moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, x+0, y-1);
-          moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, x+0, y+1);
-        });
-        float minWt = moveWeights[EA_NOP];
-        SteerDir dsd;
-        for (size_t i = 0; i < EA_MOVE_END; ++i)
-          if (moveWeights[i] < minWt)
-          {
-            minWt = moveWeights[i];
-            dsd = SteerDir{get_vec(Actions(i)) * ms.speed - vel};
-          }
-        sd = {dsd.x * 1.1, dsd.y * 1.1};
-      });
+      const SteerSnapshot *snap = it.world().get<SteerSnapshot>();
+      const FlowFieldData *flow = sm.mode == SteerSeek ? snap->approachFlow :
+                                  sm.mode == SteerFlee ? snap->fleeFlow : nullptr;
+      if (flow)
+        sd = follow_flow(*flow, ms, vel, pos);
     });
 
   // pursuer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Pursuer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Pursuer &)
+  ecs.system<const Position, Velocity, const MoveSpeed, SteerDir, const SteerAccel>()
+    .term<Pursuer>()
+    .multi_threaded()
+    .iter([](flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms, SteerDir *sd, const SteerAccel *sa)
     {
-      /*playerPosQuery*/ecs.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
-      {
-        constexpr float predictTime = 4.f;
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(targetPos - p) * ms.speed - vel};
-      });
+      const SteerSnapshot *snap = it.world().get<SteerSnapshot>();
+      if (!snap->hasPlayer)
+        return;
+      SteerSoA &soa = gather_chunk(it, pos, vel, ms, sd, sa);
+      steer::batch_pursue(soa, 0, soa.size(), snap->playerPos, snap->playerVel);
+      soa.write_back(0, soa.size());
     });
 
   // evader
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Evader>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Evader &)
+  ecs.system<const Position, Velocity, const MoveSpeed, SteerDir, const SteerAccel>()
+    .term<Evader>()
+    .multi_threaded()
+    .iter([](flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms, SteerDir *sd, const SteerAccel *sa)
     {
-      /*playerPosQuery*/ecs.each([&](const Position &pp, const Velocity &pvel,
-                              const IsPlayer &)
-      {
-        constexpr float maxPredictTime = 4.f;
-        const Position dpos = p - pp;
-        const float dist = length(dpos);
-        const Position dvel = vel - pvel;
-        const float dotProduct = (dvel.x * dpos.x + dvel.y * dpos.y) * safeinv(dist);
-        const float interceptTime = dotProduct * safeinv(length(dvel));
-        const float predictTime = std::max(std::min(maxPredictTime, interceptTime * 0.9f), 1.f);
-
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(p - targetPos) * ms.speed - vel};
-      });
+      const SteerSnapshot *snap = it.world().get<SteerSnapshot>();
+      if (!snap->hasPlayer)
+        return;
+      SteerSoA &soa = gather_chunk(it, pos, vel, ms, sd, sa);
+      steer::batch_evade(soa, 0, soa.size(), snap->playerPos, snap->playerVel);
+      soa.write_back(0, soa.size());
     });
 
-  static auto otherPosQuery = ecs.query<const Position>();
-
-  // separation is expensive!!!
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Separation>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Separation &)
+  // neighbour queries only visit nearby grid cells instead of every entity
+  ecs.set<SpatialGrid>({});
+  ecs.system<SpatialGrid>()
+    .each([&](SpatialGrid &grid)
     {
-      /*otherPosQuery*/ecs.each([&](flecs::entity oe, const Position &op)
-      {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 70.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{(p - op) * safeinv(distSq) * ms.speed * thresDist - vel};
-      });
+      rebuild_spatial_grid(ecs, grid);
     });
 
-  static auto otherVelQuery = ecs.query<const Position, const Velocity>();
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Alignment>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Alignment &)
+  // flocking: separation, alignment and cohesion share one walk over the neighbours,
+  // behaviours an agent doesn't have are masked out. The behaviour tags are optional terms, so
+  // which of them an agent has is resolved once per table.
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position>()
+    .term<Separation>().optional()
+    .term<Alignment>().optional()
+    .term<Cohesion>().optional()
+    .multi_threaded()
+    .iter([](flecs::iter &it, SteerDir *sd, const Velocity *vel, const MoveSpeed *ms, const Position *pos)
     {
-      /*otherVelQuery*/ecs.each([&](flecs::entity oe, const Position &op, const Velocity &ovel)
+      const bool separation = it.is_set(5);
+      const bool alignment = it.is_set(6);
+      const bool cohesion = it.is_set(7);
+      if (!separation && !alignment && !cohesion)
+        return;
+      constexpr float separationDist = 70.f;
+      constexpr float alignmentDist = 100.f;
+      constexpr float cohesionDist = 500.f;
+      const float radius = cohesion ? cohesionDist : alignment ? alignmentDist : separationDist;
+      const float separationDistSq = separation ? separationDist * separationDist : -1.f;
+      const float alignmentDistSq = alignment ? alignmentDist * alignmentDist : -1.f;
+      const float cohesionDistSq = cohesion ? cohesionDist * cohesionDist : -1.f;
+      const SpatialGrid *grid = it.world().get<SpatialGrid>();
+
+      for (auto i : it)
       {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 100.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{ovel * 0.8f};
-      });
+        const flecs::entity ent = it.entity(i);
+        const Position &p = pos[i];
+        Position separationDir{0.f, 0.f};
+        Position alignmentDir{0.f, 0.f};
+        Position avgPos{0.f, 0.f};
+        float count = 0.f;
+        grid->each_in_radius(p, radius, [&](const SpatialGrid::Item &other)
+        {
+          if (other.entity == ent)
+            return;
+          const float distSq = length_sq(other.pos - p);
+          const float separationMask = distSq <= separationDistSq ? 1.f : 0.f;
+          const float alignmentMask = distSq <= alignmentDistSq ? 1.f : 0.f;
+          const float cohesionMask = distSq <= cohesionDistSq ? 1.f : 0.f;
+          separationDir += ((p - other.pos) * safeinv(distSq) * ms[i].speed * separationDist - vel[i]) * separationMask;
+          alignmentDir += other.vel * (0.8f * alignmentMask);
+          avgPos += other.pos * cohesionMask;
+          count += cohesionMask;
+        });
+        sd[i] += SteerDir{separationDir + alignmentDir};
+        if (cohesion)
+        {
+          constexpr float avgPosMult = 100.f;
+          sd[i] += SteerDir{normalize(avgPos * safeinv(count) - p) * avgPosMult - vel[i]};
+        }
+      }
     });
 
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Cohesion>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Cohesion &)
+  // local avoidance: the velocity steering came up with is corrected against the nearest neighbours
+  ecs.system<Velocity, const MoveSpeed, const Position, const SteerAccel>()
+    .multi_threaded()
+    .each([](flecs::iter &it, size_t i, Velocity &vel, const MoveSpeed &ms, const Position &p, const SteerAccel &)
     {
-      Position avgPos{0.f, 0.f};
+      const flecs::entity ent = it.entity(i);
+      constexpr float neighbourDist = 3.f * dungeon::tile_size;
+      orca::Neighbour neighbours[orca::max_neighbours];
+      float neighbourDistSq[orca::max_neighbours];
       size_t count = 0;
-      /*otherPosQuery*/ecs.each([&](flecs::entity oe, const Position &op)
+      it.world().get<SpatialGrid>()->each_in_radius(p, neighbourDist, [&](const SpatialGrid::Item &other)
       {
-        if (oe == ent)
+        if (other.entity == ent)
           return;
-        constexpr float thresDist = 500.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
+        const float distSq = length_sq(other.pos - p);
+        if (count == orca::max_neighbours && distSq >= neighbourDistSq[count - 1])
           return;
-        count++;
-        avgPos += op;
+        // keep the k closest sorted by distance
+        size_t j = count < orca::max_neighbours ? count++ : count - 1;
+        for (; j > 0 && neighbourDistSq[j - 1] > distSq; --j)
+        {
+          neighbourDistSq[j] = neighbourDistSq[j - 1];
+          neighbours[j] = neighbours[j - 1];
+        }
+        neighbourDistSq[j] = distSq;
+        neighbours[j] = orca::Neighbour{other.pos, other.vel};
       });
-      constexpr float avgPosMult = 100.f;
-      sd += SteerDir{normalize(avgPos * safeinv(float(count)) - p) * avgPosMult - vel};
+      orca::Params params;
+      params.radius = 0.3f * dungeon::tile_size;
+      params.maxSpeed = ms.speed;
+      params.dt = it.delta_time();
+      vel = orca::avoid(p, vel, neighbours, count, params);
     });
-
 }
-
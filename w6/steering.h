@@ -1,5 +1,19 @@
 #pragma once
 #include <flecs.h>
+#include <cstdint>
+
+// flow field a steerer follows, switched in place by the behaviour tree so the entity keeps its table
+enum SteerModeType : uint8_t
+{
+  SteerNone = 0,
+  SteerSeek,
+  SteerFlee
+};
+
+struct SteerMode
+{
+  SteerModeType mode = SteerNone;
+};
 
 namespace steer
 {
@@ -13,6 +27,10 @@ namespace steer
   };
 
   flecs::entity create_steerer(flecs::entity e);
+  // same set of steering components, overridden so that instances own them
+  flecs::entity create_steerer_prefab(flecs::entity prefab);
+  // clears steering state of a steerer that is about to be reused
+  void reset_steerer(flecs::entity e);
 
   flecs::entity create_steer_beh(flecs::entity e, Type type);
 
@@ -21,13 +39,14 @@ namespace steer
   flecs::entity create_evader(flecs::entity e);
   flecs::entity create_fleer(flecs::entity e);
 
+  // writes the mode only when it actually changes, so OnSet and change detection see real transitions
+  void set_steer_mode(flecs::entity e, SteerModeType mode);
+
   void register_systems(flecs::world &ecs);
 };
 
-struct Seeker {};
 struct Pursuer {};
 struct Evader {};
-struct Fleer {};
 struct Separation {};
 struct Alignment {};
 struct Cohesion {};
@@ -0,0 +1,106 @@
+#include "tileCollision.h"
+#include "allocTracker.h"
+#include "dungeonUtils.h"
+#include <cmath>
+#include <algorithm>
+
+// hitbox relative to the entity position, in tiles
+constexpr float hitLeft = 0.15f;
+constexpr float hitRight = 0.75f;
+constexpr float hitTop = 0.75f;
+constexpr float hitBottom = 0.95f;
+// gap kept between a hitbox and the wall it was stopped by
+constexpr float skin = 1e-3f;
+
+WalkableGrid make_walkable_grid(const DungeonData &dd)
+{
+  WalkableGrid grid;
+  grid.width = int(dd.width);
+  grid.height = int(dd.height);
+  grid.wordsPerRow = (dd.width + 63) / 64;
+  grid.originX = dd.originX;
+  grid.originY = dd.originY;
+  grid.bits.assign(grid.wordsPerRow * dd.height, 0);
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] == dungeon::floor)
+        grid.bits[y * grid.wordsPerRow + x / 64] |= uint64_t(1) << (x % 64);
+  return grid;
+}
+
+bool WalkableGrid::is_row_walkable(int y, int x0, int x1) const
+{
+  y -= originY;
+  x0 -= originX;
+  x1 -= originX;
+  if (y < 0 || y >= height || x0 < 0 || x1 >= width)
+    return false;
+  const uint64_t *row = &bits[size_t(y) * wordsPerRow];
+  for (int x = x0; x <= x1;)
+  {
+    const int bit = x % 64;
+    const int count = std::min(64 - bit, x1 - x + 1);
+    const uint64_t mask = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+    if ((row[x / 64] & mask) != mask)
+      return false;
+    x += count;
+  }
+  return true;
+}
+
+bool WalkableGrid::is_column_walkable(int x, int y0, int y1) const
+{
+  for (int y = y0; y <= y1; ++y)
+    if (!is_walkable(x, y))
+      return false;
+  return true;
+}
+
+static int tile_of(float coord)
+{
+  return int(std::floor(coord / dungeon::tile_size));
+}
+
+// how far the box [lo, hi] can travel by delta along its axis before entering a blocked line of tiles,
+// blocked(line) tests one whole column (or row) of tiles across the box
+template<typename Blocked>
+static float sweep(float lo, float hi, float delta, Blocked blocked)
+{
+  if (delta > 0.f)
+  {
+    for (int line = tile_of(hi) + 1, last = tile_of(hi + delta); line <= last; ++line)
+      if (blocked(line))
+        return std::max(0.f, line * dungeon::tile_size - skin - hi);
+  }
+  else if (delta < 0.f)
+  {
+    for (int line = tile_of(lo) - 1, last = tile_of(lo + delta); line >= last; --line)
+      if (blocked(line))
+        return std::min(0.f, (line + 1) * dungeon::tile_size + skin - lo);
+  }
+  return delta;
+}
+
+void dungeon::move_and_collide(const WalkableGrid &grid, Position &pos, Velocity &vel, float dt)
+{
+  ZERO_ALLOC_SCOPE("dungeon::move_and_collide");
+  const float ts = dungeon::tile_size;
+
+  const float dx = vel.x * dt;
+  const int rowTop = tile_of(pos.y + hitTop * ts);
+  const int rowBottom = tile_of(pos.y + hitBottom * ts);
+  const float movedX = sweep(pos.x + hitLeft * ts, pos.x + hitRight * ts, dx,
+                             [&](int col) { return !grid.is_column_walkable(col, rowTop, rowBottom); });
+  pos.x += movedX;
+  if (movedX != dx)
+    vel.x = 0.f;
+
+  const float dy = vel.y * dt;
+  const int colLeft = tile_of(pos.x + hitLeft * ts);
+  const int colRight = tile_of(pos.x + hitRight * ts);
+  const float movedY = sweep(pos.y + hitTop * ts, pos.y + hitBottom * ts, dy,
+                             [&](int row) { return !grid.is_row_walkable(row, colLeft, colRight); });
+  pos.y += movedY;
+  if (movedY != dy)
+    vel.y = 0.f;
+}
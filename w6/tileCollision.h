@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+
+// One bit per tile, set for walkable tiles. Built once per dungeon so the collision stage
+// tests a whole row span of tiles with a couple of word operations.
+struct WalkableGrid
+{
+  std::vector<uint64_t> bits;
+  int width = 0;
+  int height = 0;
+  size_t wordsPerRow = 0;
+  // level tile of bit 0, lookups take level tiles and everything off the window is a wall
+  int originX = 0;
+  int originY = 0;
+
+  bool is_walkable(int x, int y) const
+  {
+    x -= originX;
+    y -= originY;
+    if (x < 0 || x >= width || y < 0 || y >= height)
+      return false;
+    return (bits[size_t(y) * wordsPerRow + size_t(x) / 64] >> (size_t(x) % 64)) & 1u;
+  }
+  // every tile of row y in [x0, x1] is walkable
+  bool is_row_walkable(int y, int x0, int x1) const;
+  // every tile of column x in [y0, y1] is walkable
+  bool is_column_walkable(int x, int y0, int y1) const;
+};
+
+WalkableGrid make_walkable_grid(const DungeonData &dd);
+
+namespace dungeon
+{
+  // Moves an entity at pos by delta, stopping its hitbox in front of the first wall crossed on
+  // each axis (x first, then y). Velocity along a blocked axis is zeroed so agents slide along walls.
+  void move_and_collide(const WalkableGrid &grid, Position &pos, Velocity &vel, float dt);
+};
@@ -0,0 +1,101 @@
+#include "tileMap.h"
+#include <algorithm>
+#include "dungeonUtils.h"
+
+TileMap bake_tile_map(const char *tiles, size_t w, size_t h, int origin_x, int origin_y, float tile_size,
+                      const SpriteAtlas &atlas, const SpriteRegion &wall, const SpriteRegion &floor)
+{
+  TileMap tileMap;
+  update_tile_map(tileMap, tiles, w, h, origin_x, origin_y, tile_size);
+  bake_pending_chunks(tileMap, tileMap.pending.size(), atlas, wall, floor);
+  return tileMap;
+}
+
+void update_tile_map(TileMap &tile_map, const char *tiles, size_t w, size_t h, int origin_x, int origin_y,
+                     float tile_size)
+{
+  std::vector<TileMap::Chunk> chunks;
+  std::vector<bool> kept(tile_map.chunks.size(), false);
+  tile_map.pending.clear();
+  for (size_t cy = 0; cy < h; cy += TileMap::chunk_size)
+    for (size_t cx = 0; cx < w; cx += TileMap::chunk_size)
+    {
+      const size_t cw = std::min(TileMap::chunk_size, w - cx);
+      const size_t ch = std::min(TileMap::chunk_size, h - cy);
+      const Rectangle bounds{float(origin_x + int(cx)) * tile_size, float(origin_y + int(cy)) * tile_size,
+                             cw * tile_size, ch * tile_size};
+      auto same = [&](const TileMap::Chunk &old)
+      {
+        return old.bounds.x == bounds.x && old.bounds.y == bounds.y &&
+               old.bounds.width == bounds.width && old.bounds.height == bounds.height;
+      };
+      auto found = std::find_if(tile_map.chunks.begin(), tile_map.chunks.end(), same);
+      if (found != tile_map.chunks.end())
+      {
+        kept[found - tile_map.chunks.begin()] = true;
+        chunks.push_back(*found);
+        continue;
+      }
+      TileMap::PendingChunk chunk{bounds, cw, ch, std::vector<char>(cw * ch)};
+      for (size_t y = 0; y < ch; ++y)
+        std::copy_n(tiles + (cy + y) * w + cx, cw, chunk.tiles.begin() + y * cw);
+      tile_map.pending.push_back(std::move(chunk));
+    }
+  // chunks a window leaves are a whole chunk away from the player, off screen by the time they go
+  for (size_t i = 0; i < tile_map.chunks.size(); ++i)
+    if (!kept[i])
+      UnloadRenderTexture(tile_map.chunks[i].target);
+  tile_map.chunks = std::move(chunks);
+}
+
+void bake_pending_chunks(TileMap &tile_map, size_t max_count,
+                         const SpriteAtlas &atlas, const SpriteRegion &wall, const SpriteRegion &floor)
+{
+  for (size_t n = 0; n < max_count && !tile_map.pending.empty(); ++n)
+  {
+    const TileMap::PendingChunk &pending = tile_map.pending.back();
+    TileMap::Chunk chunk;
+    chunk.bounds = pending.bounds;
+    chunk.target = LoadRenderTexture(int(pending.width) * TileMap::texels_per_tile,
+                                     int(pending.height) * TileMap::texels_per_tile);
+    SetTextureFilter(chunk.target.texture, TEXTURE_FILTER_BILINEAR);
+    BeginTextureMode(chunk.target);
+      ClearBackground(BLANK);
+      for (size_t y = 0; y < pending.height; ++y)
+        for (size_t x = 0; x < pending.width; ++x)
+        {
+          const char tile = pending.tiles[y * pending.width + x];
+          if (tile != dungeon::wall && tile != dungeon::floor)
+            continue;
+          const SpriteRegion &region = tile == dungeon::wall ? wall : floor;
+          DrawTexturePro(atlas.pages[region.page], region.rect,
+                         Rectangle{float(x * TileMap::texels_per_tile), float(y * TileMap::texels_per_tile),
+                                   float(TileMap::texels_per_tile), float(TileMap::texels_per_tile)},
+                         Vector2{0.f, 0.f}, 0.f, WHITE);
+        }
+    EndTextureMode();
+    tile_map.chunks.push_back(chunk);
+    tile_map.pending.pop_back();
+  }
+}
+
+void set_tile_map(flecs::world &ecs, const TileMap &tile_map)
+{
+  ecs.observer<TileMap>()
+    .event(flecs::OnRemove)
+    .each([](TileMap &map)
+    {
+      for (const TileMap::Chunk &chunk : map.chunks)
+        UnloadRenderTexture(chunk.target);
+      map.chunks.clear();
+    });
+  ecs.set<TileMap>(tile_map);
+}
+
+void draw_tile_chunk(const TileMap::Chunk &chunk)
+{
+  // render textures are stored upside down, and at texels_per_tile they're scaled up to the tile size
+  const Texture2D &tex = chunk.target.texture;
+  const Rectangle src{0.f, 0.f, float(tex.width), -float(tex.height)};
+  DrawTexturePro(tex, src, chunk.bounds, Vector2{0.f, 0.f}, 0.f, WHITE);
+}
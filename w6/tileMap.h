@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <raylib.h>
+#include <flecs.h>
+#include "spriteAtlas.h"
+
+// Dungeon background baked into render textures of chunk_size x chunk_size tiles,
+// replaces an entity and a draw call per tile with a draw call per chunk.
+struct TileMap
+{
+  // same as ChunkedDungeon::chunk_size, a dungeon window always covers whole tile map chunks
+  static constexpr size_t chunk_size = 64;
+  // baked below the 512px source art and drawn scaled up, keeps a chunk target at 4 MB
+  static constexpr int texels_per_tile = 16;
+
+  struct Chunk
+  {
+    Rectangle bounds; // in world coordinates
+    RenderTexture2D target;
+  };
+  std::vector<Chunk> chunks;
+
+  // chunks a moved window needs that aren't baked yet, with a copy of their tiles
+  struct PendingChunk
+  {
+    Rectangle bounds;
+    size_t width;
+    size_t height;
+    std::vector<char> tiles;
+  };
+  std::vector<PendingChunk> pending;
+};
+
+// tiles[0] is level tile (origin_x, origin_y), every chunk is baked right away
+TileMap bake_tile_map(const char *tiles, size_t w, size_t h, int origin_x, int origin_y, float tile_size,
+                      const SpriteAtlas &atlas, const SpriteRegion &wall, const SpriteRegion &floor);
+// for a dungeon window that moved: chunks it still covers are kept, chunks it left are unloaded
+// and new ones are queued for bake_pending_chunks
+void update_tile_map(TileMap &tile_map, const char *tiles, size_t w, size_t h, int origin_x, int origin_y,
+                     float tile_size);
+// bakes up to max_count queued chunks, needs the GL context and has to run outside BeginMode2D
+void bake_pending_chunks(TileMap &tile_map, size_t max_count,
+                         const SpriteAtlas &atlas, const SpriteRegion &wall, const SpriteRegion &floor);
+// sets the TileMap singleton, its render textures are unloaded when it's removed from the world
+void set_tile_map(flecs::world &ecs, const TileMap &tile_map);
+void draw_tile_chunk(const TileMap::Chunk &chunk);
@@ -0,0 +1,29 @@
+#include "worldRegistry.h"
+
+void init_world_registry(flecs::world &ecs)
+{
+  WorldRegistry reg;
+  reg.player = ecs.entity("player");
+  reg.exit = ecs.entity("exit");
+  reg.camera = ecs.entity("camera");
+  reg.dungeon = ecs.entity("dungeon");
+  reg.approachMap = ecs.entity("approach_map");
+  reg.fleeMap = ecs.entity("flee_map");
+  reg.wallTex = ecs.entity("wall_tex");
+  reg.floorTex = ecs.entity("floor_tex");
+
+  reg.players = ecs.query<const Position, const IsPlayer>();
+  reg.playerMotion = ecs.query<const Position, const Velocity, const IsPlayer>();
+  reg.teamPositions = ecs.query<const Position, const Team>();
+  reg.attackers = ecs.query<const Position, const MeleeDamage, const MeleeDist, const Team>();
+  reg.attackTargets = ecs.query<const Position, Hitpoints, const Team>();
+  reg.hitpoints = ecs.query<const Hitpoints>();
+  reg.behaviourTrees = ecs.query<BehaviourTree, Blackboard>();
+  reg.worldInfoGatherers = ecs.query<Blackboard, const Position, const Hitpoints, const WorldInfoGatherer, const Team>();
+  reg.cameras = ecs.query<Camera2D>();
+  reg.monsters = ecs.query_builder<const Position>().with<Team>().without<IsPlayer>().build();
+  reg.spawners = ecs.query<const Position, const MonsterSpawner>();
+  // a Disabled term is what lets a query match disabled entities
+  reg.sleepers = ecs.query_builder<const Position>().with<Asleep>().with(flecs::Disabled).build();
+  ecs.set<WorldRegistry>(reg);
+}
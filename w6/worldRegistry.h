@@ -0,0 +1,46 @@
+#pragma once
+#include <cassert>
+#include <flecs.h>
+#include <raylib.h>
+#include "ecsTypes.h"
+#include "behaviourTree.h"
+#include "rlikeObjects.h"
+
+// Handles and cached queries for the hot paths, so they don't look entities up by name or
+// build a new iteration every call. It's a world singleton: ecs.reset() drops it together with
+// everything it points to, init_world_registry runs again from init_shoot_em_up after each reset.
+struct WorldRegistry
+{
+  flecs::entity player;
+  flecs::entity exit;
+  flecs::entity camera;
+  flecs::entity dungeon;
+  flecs::entity approachMap;
+  flecs::entity fleeMap;
+  flecs::entity wallTex;
+  flecs::entity floorTex;
+
+  flecs::query<const Position, const IsPlayer> players;
+  flecs::query<const Position, const Velocity, const IsPlayer> playerMotion;
+  flecs::query<const Position, const Team> teamPositions;
+  flecs::query<const Position, const MeleeDamage, const MeleeDist, const Team> attackers;
+  flecs::query<const Position, Hitpoints, const Team> attackTargets;
+  flecs::query<const Hitpoints> hitpoints;
+  flecs::query<BehaviourTree, Blackboard> behaviourTrees;
+  flecs::query<Blackboard, const Position, const Hitpoints, const WorldInfoGatherer, const Team> worldInfoGatherers;
+  flecs::query<Camera2D> cameras;
+  // what sleeps off the streamed in window: monsters, spawners, and the ones already asleep
+  flecs::query<const Position> monsters;
+  flecs::query<const Position, const MonsterSpawner> spawners;
+  flecs::query<const Position> sleepers;
+};
+
+// creates the named entities up front, the code filling them later gets the same ids by name
+void init_world_registry(flecs::world &ecs);
+
+inline const WorldRegistry &registry(const flecs::world &ecs)
+{
+  const WorldRegistry *reg = ecs.get<WorldRegistry>();
+  assert(reg && "init_world_registry hasn't run for this world");
+  return *reg;
+}
@@ -14,6 +14,9 @@ struct Position
 
 struct Velocity : public Position {};
 
+// position before the last simulation step, used to interpolate rendering
+struct PrevPosition : public Position {};
+
 struct SteerDir : public Position {};
 
 inline Position operator-(const Position &lhs, const Position &rhs)
@@ -156,8 +159,6 @@ struct ActionLog
   size_t capacity = 5;
 };
 
-struct BackgroundTile {};
-
 struct DungeonData
 {
   std::vector<char> tiles; // for pathfinding
@@ -0,0 +1,58 @@
+#include "fixedStep.h"
+
+void register_pipelines(flecs::world &ecs)
+{
+  SimPipelines pipelines;
+  pipelines.simulation = ecs.pipeline()
+    .with(flecs::System)
+    .with(flecs::DependsOn, flecs::OnUpdate)
+    .build();
+  pipelines.render = ecs.pipeline()
+    .with(flecs::System)
+    .with(flecs::DependsOn, flecs::OnStore)
+    .build();
+  ecs.set<SimPipelines>(pipelines);
+  ecs.set<RenderAlpha>({});
+
+  // remember where moving entities were before the step, for render interpolation
+  ecs.system<PrevPosition, const Position>()
+    .multi_threaded()
+    .each([](PrevPosition &prev, const Position &pos)
+    {
+      prev = PrevPosition{pos};
+    });
+}
+
+bool step_simulation(flecs::world &ecs, float dt, int steps, SimStepFn pre_step)
+{
+  ecs.set_pipeline(ecs.get<SimPipelines>()->simulation);
+  for (int i = 0; i < steps; ++i)
+  {
+    if (pre_step)
+      pre_step(ecs, dt);
+    if (!ecs.progress(dt))
+      return false;
+  }
+  return true;
+}
+
+bool run_fixed_steps(flecs::world &ecs, FixedStepClock &clock, float frame_time, SimStepFn pre_step)
+{
+  clock.accumulator += frame_time;
+  int steps = 0;
+  while (clock.accumulator >= clock.step && steps < clock.maxSubSteps)
+  {
+    clock.accumulator -= clock.step;
+    ++steps;
+  }
+  if (steps == clock.maxSubSteps && clock.accumulator >= clock.step)
+    clock.accumulator = 0.f;
+  return step_simulation(ecs, clock.step, steps, pre_step);
+}
+
+void render_frame(flecs::world &ecs, const FixedStepClock &clock, float frame_time)
+{
+  ecs.set<RenderAlpha>({clock.accumulator / clock.step});
+  ecs.set_pipeline(ecs.get<SimPipelines>()->render);
+  ecs.progress(frame_time);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <flecs.h>
+#include "ecsTypes.h"
+
+// Simulation systems stay in OnUpdate and advance with a fixed delta time, render systems are
+// registered with .kind(flecs::OnStore) and run once per displayed frame.
+struct SimPipelines
+{
+  flecs::entity simulation;
+  flecs::entity render;
+};
+
+// how far the render frame is between the last two simulation steps, in [0, 1]
+struct RenderAlpha
+{
+  float alpha = 1.f;
+};
+
+// lives outside the world so it survives ecs.reset()
+struct FixedStepClock
+{
+  float step = 1.f / 60.f;
+  float accumulator = 0.f;
+  int maxSubSteps = 8; // a long frame drops time instead of spiralling into more and more steps
+};
+
+void register_pipelines(flecs::world &ecs);
+
+// game logic that runs outside the flecs pipeline, called before every simulation tick with its dt
+using SimStepFn = void (*)(flecs::world &ecs, float dt);
+
+// runs steps simulation ticks of dt each, returns false once the simulation asked to quit
+bool step_simulation(flecs::world &ecs, float dt, int steps = 1, SimStepFn pre_step = nullptr);
+// runs as many fixed steps as the frame time accumulated so far allows
+bool run_fixed_steps(flecs::world &ecs, FixedStepClock &clock, float frame_time, SimStepFn pre_step = nullptr);
+void render_frame(flecs::world &ecs, const FixedStepClock &clock, float frame_time);
+
+// position to draw an entity at, between its previous and current simulation positions
+inline Position render_position(flecs::entity e, const Position &pos)
+{
+  const PrevPosition *prev = e.get<PrevPosition>();
+  const RenderAlpha *ra = e.world().get<RenderAlpha>();
+  if (!prev || !ra)
+    return pos;
+  return *prev + (pos - *prev) * ra->alpha;
+}
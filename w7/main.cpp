@@ -1,10 +1,13 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <thread>
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
 #include "dungeonGen.h"
+#include "fixedStep.h"
+#include "spriteAtlas.h"
 
 static void update_camera(flecs::world &ecs)
 {
@@ -38,6 +41,8 @@ int main(int /*argc*/, const char ** /*argv*/)
   }
 
   flecs::world ecs;
+  // steering and movement systems are split between worker threads
+  ecs.set_threads(int(std::max(1u, std::thread::hardware_concurrency())));
   {
     constexpr size_t dungWidth = 50;
     constexpr size_t dungHeight = 50;
@@ -56,21 +61,26 @@ int main(int /*argc*/, const char ** /*argv*/)
     .set(Camera2D{camera});
 
   SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
+  FixedStepClock clock;
   while (!WindowShouldClose())
   {
     static auto cameraQuery = ecs.query<Camera2D>();
-    process_game(ecs);
+    const float frameTime = GetFrameTime();
+    run_fixed_steps(ecs, clock, frameTime, process_game);
     update_camera(ecs);
 
     BeginDrawing();
       ClearBackground(BLACK);
       cameraQuery.each([&](Camera2D &cam) { BeginMode2D(cam); });
-        ecs.progress();
+        render_frame(ecs, clock, frameTime);
       EndMode2D();
       // Advance to next frame. Process submitted rendering primitives.
     EndDrawing();
   }
 
+  // the tile map unloads its render textures when it's removed, that needs the GL context
+  ecs.reset();
+  unload_sprite_atlas();
   CloseWindow();
 
   return 0;
@@ -6,6 +6,7 @@ flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const c
   flecs::entity textureSrc = ecs.entity(texture_src);
   return ecs.entity()
     .set(Position{pos.x, pos.y})
+    .set(PrevPosition{pos.x, pos.y})
     .set(Velocity{0.f, 0.f})
     .set(MoveSpeed{100.f})
     .set(Hitpoints{100.f})
@@ -22,6 +23,7 @@ void create_player(flecs::world &ecs, Position pos, const char *texture_src)
   flecs::entity textureSrc = ecs.entity(texture_src);
   ecs.entity("player")
     .set(Position{pos.x, pos.y})
+    .set(PrevPosition{pos.x, pos.y})
     .set(Velocity{0.f, 0.f})
     .set(MoveSpeed{350.f})
     .set(Hitpoints{100.f})
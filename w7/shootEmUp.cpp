@@ -6,6 +6,9 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "fixedStep.h"
+#include "tileMap.h"
+#include "spriteBatch.h"
 
 constexpr float tile_size = 64.f;
 
@@ -13,6 +16,9 @@ static void register_roguelike_systems(flecs::world &ecs)
 {
   static auto playerPosQuery = ecs.query<const Position, const IsPlayer>();
 
+  register_pipelines(ecs);
+  ecs.set<SpriteBatch>({});
+
   ecs.system<Velocity, const MoveSpeed, const IsPlayer>()
     .each([&](Velocity &vel, const MoveSpeed &ms, const IsPlayer)
     {
@@ -25,43 +31,42 @@ static void register_roguelike_systems(flecs::world &ecs)
       vel = Velocity{normalize(vel) * ms.speed};
     });
   ecs.system<Position, const Velocity>()
-    .each([&](Position &pos, const Velocity &vel)
+    .multi_threaded()
+    .each([](flecs::iter &it, size_t, Position &pos, const Velocity &vel)
     {
-      pos += vel * ecs.delta_time();
+      pos += vel * it.delta_time();
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+  ecs.system<const TileMap>()
+    .kind(flecs::OnStore)
+    .each([](const TileMap &tileMap)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x), float(pos.y), tile_size, tile_size}, color);
+      draw_tile_map(tileMap);
     });
   ecs.system<const Position, const Color>()
     .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>().not_()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+    .kind(flecs::OnStore)
+    .each([&](flecs::entity e, const Position &simPos, const Color color)
     {
+      const Position pos = render_position(e, simPos);
       const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
+      ecs.get_mut<SpriteBatch>()->push(sprite_layer_characters, *textureSrc.get<SpriteRegion>(),
           Rectangle{float(pos.x), float(pos.y), tile_size, tile_size}, color);
     });
 
-  ecs.system<Texture2D>()
-    .each([&](Texture2D &tex)
+  // everything pushed to the batch above is drawn here, sorted by layer and atlas page
+  ecs.system<SpriteBatch>()
+    .kind(flecs::OnStore)
+    .each([](SpriteBatch &batch)
     {
-      SetTextureFilter(tex, TEXTURE_FILTER_POINT);
+      batch.flush(get_sprite_atlas());
     });
 
   ecs.system<MonsterSpawner>()
-    .each([&](MonsterSpawner &ms)
+    .each([&](flecs::iter &it, size_t, MonsterSpawner &ms)
     {
       playerPosQuery.each([&](const Position &pp, const IsPlayer &)
       {
-        ms.timeToSpawn -= ecs.delta_time();
+        ms.timeToSpawn -= it.delta_time();
         while (ms.timeToSpawn < 0.f)
         {
           steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
@@ -80,6 +85,7 @@ static void register_roguelike_systems(flecs::world &ecs)
 
   static auto cameraQuery = ecs.query<const Camera2D>();
   ecs.system<const DungeonPortals, const DungeonData>()
+    .kind(flecs::OnStore)
     .each([&](const DungeonPortals &dp, const DungeonData &dd)
     {
       size_t w = dd.width;
@@ -146,9 +152,9 @@ void init_shoot_em_up(flecs::world &ecs)
   register_roguelike_systems(ecs);
 
   ecs.entity("swordsman_tex")
-    .set(Texture2D{LoadTexture("assets/swordsman.png")});
+    .set(get_sprite_atlas().get("swordsman"));
   ecs.entity("minotaur_tex")
-    .set(Texture2D{LoadTexture("assets/minotaur.png")});
+    .set(get_sprite_atlas().get("minotaur"));
 
   const Position walkableTile = dungeon::find_walkable_tile(ecs);
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
@@ -157,9 +163,9 @@ void init_shoot_em_up(flecs::world &ecs)
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
 {
   flecs::entity wallTex = ecs.entity("wall_tex")
-    .set(Texture2D{LoadTexture("assets/wall.png")});
+    .set(get_sprite_atlas().get("wall"));
   flecs::entity floorTex = ecs.entity("floor_tex")
-    .set(Texture2D{LoadTexture("assets/floor.png")});
+    .set(get_sprite_atlas().get("floor"));
 
   std::vector<char> dungeonData;
   dungeonData.resize(w * h);
@@ -169,23 +175,12 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   ecs.entity("dungeon")
     .set(DungeonData{dungeonData, w, h});
 
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-    {
-      char tile = tiles[y * w + x];
-      flecs::entity tileEntity = ecs.entity()
-        .add<BackgroundTile>()
-        .set(Position{float(x) * tile_size, float(y) * tile_size})
-        .set(Color{255, 255, 255, 255});
-      if (tile == dungeon::wall)
-        tileEntity.add<TextureSource>(wallTex);
-      else if (tile == dungeon::floor)
-        tileEntity.add<TextureSource>(floorTex);
-    }
+  set_tile_map(ecs, bake_tile_map(tiles, w, h, tile_size, get_sprite_atlas(),
+                                    *wallTex.get<SpriteRegion>(), *floorTex.get<SpriteRegion>()));
   prebuild_map(ecs);
 }
 
-void process_game(flecs::world &ecs)
+void process_game(flecs::world &, float)
 {
 }
 
@@ -2,6 +2,7 @@
 #include <flecs.h>
 
 void init_shoot_em_up(flecs::world &ecs);
-void process_game(flecs::world &ecs);
+// one simulation tick of the game logic outside the flecs pipeline, passed to the fixed step loop
+void process_game(flecs::world &ecs, float dt);
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
 
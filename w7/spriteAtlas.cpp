@@ -0,0 +1,81 @@
+#include "spriteAtlas.h"
+#include <algorithm>
+
+constexpr int atlas_page_size = 2048;
+constexpr int atlas_padding = 1; // keeps neighbours from bleeding into each other
+
+static SpriteAtlas build_sprite_atlas(const char *dir)
+{
+  struct Entry
+  {
+    std::string name;
+    Image image;
+  };
+  std::vector<Entry> entries;
+  FilePathList files = LoadDirectoryFilesEx(dir, ".png", false);
+  for (unsigned int i = 0; i < files.count; ++i)
+    entries.push_back({GetFileNameWithoutExt(files.paths[i]), LoadImage(files.paths[i])});
+  UnloadDirectoryFiles(files);
+
+  // shelf packing, tallest images first
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+  {
+    return a.image.height > b.image.height;
+  });
+
+  SpriteAtlas atlas;
+  std::vector<Image> pageImages;
+  int x = 0, y = 0, shelfHeight = 0;
+  for (const Entry &entry : entries)
+  {
+    const int w = entry.image.width + atlas_padding;
+    const int h = entry.image.height + atlas_padding;
+    if (x + w > atlas_page_size)
+    {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+    if (pageImages.empty() || y + h > atlas_page_size)
+    {
+      pageImages.push_back(GenImageColor(atlas_page_size, atlas_page_size, BLANK));
+      x = y = shelfHeight = 0;
+    }
+    const Rectangle src{0.f, 0.f, float(entry.image.width), float(entry.image.height)};
+    const Rectangle dst{float(x), float(y), src.width, src.height};
+    ImageDraw(&pageImages.back(), entry.image, src, dst, WHITE);
+    atlas.regions[entry.name] = SpriteRegion{int(pageImages.size()) - 1, dst};
+    x += w;
+    shelfHeight = std::max(shelfHeight, h);
+  }
+  for (Entry &entry : entries)
+    UnloadImage(entry.image);
+  for (Image &image : pageImages)
+  {
+    Texture2D page = LoadTextureFromImage(image);
+    SetTextureFilter(page, TEXTURE_FILTER_POINT);
+    atlas.pages.push_back(page);
+    UnloadImage(image);
+  }
+  return atlas;
+}
+
+static SpriteAtlas &atlas_storage()
+{
+  static SpriteAtlas atlas = build_sprite_atlas("assets");
+  return atlas;
+}
+
+const SpriteAtlas &get_sprite_atlas()
+{
+  return atlas_storage();
+}
+
+void unload_sprite_atlas()
+{
+  SpriteAtlas &atlas = atlas_storage();
+  for (const Texture2D &page : atlas.pages)
+    UnloadTexture(page);
+  atlas.pages.clear();
+  atlas.regions.clear();
+}
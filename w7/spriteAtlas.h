@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <raylib.h>
+
+// part of an atlas page a sprite is drawn from, set on texture entities next to TextureSource targets
+struct SpriteRegion
+{
+  int page = 0;
+  Rectangle rect = {0.f, 0.f, 0.f, 0.f};
+};
+
+// Every png from the assets directory packed into as few textures as fit.
+// Lives outside of the world, so it is built once and survives ecs.reset().
+struct SpriteAtlas
+{
+  std::vector<Texture2D> pages;
+  std::unordered_map<std::string, SpriteRegion> regions; // by file name without extension
+
+  // empty region if there was no such file
+  SpriteRegion get(const char *name) const
+  {
+    auto it = regions.find(name);
+    return it != regions.end() ? it->second : SpriteRegion{};
+  }
+};
+
+// built on the first call, needs the window to be initialized
+const SpriteAtlas &get_sprite_atlas();
+void unload_sprite_atlas();
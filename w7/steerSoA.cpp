@@ -0,0 +1,221 @@
+#include "steerSoA.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STEER_SSE 1
+#include <emmintrin.h>
+#endif
+
+// Kernels are written once against a small set of lane helpers. They are instantiated for the
+// widest available vector type for the bulk of agents and for plain float for the tail. That's
+// 4-wide SSE2 in the default build and 8-wide AVX2 with ENABLE_AVX2.
+namespace
+{
+#if defined(__AVX2__)
+  struct vfloat { __m256 v; };
+  constexpr size_t lanes = 8;
+  inline vfloat load(const float *p, vfloat) { return {_mm256_loadu_ps(p)}; }
+  inline void store(float *p, vfloat a) { _mm256_storeu_ps(p, a.v); }
+  inline vfloat splat(float a, vfloat) { return {_mm256_set1_ps(a)}; }
+  inline vfloat operator+(vfloat a, vfloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+  inline vfloat operator-(vfloat a, vfloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+  inline vfloat operator*(vfloat a, vfloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  inline vfloat operator/(vfloat a, vfloat b) { return {_mm256_div_ps(a.v, b.v)}; }
+  inline vfloat vsqrt(vfloat a) { return {_mm256_sqrt_ps(a.v)}; }
+  inline vfloat vmin(vfloat a, vfloat b) { return {_mm256_min_ps(a.v, b.v)}; }
+  inline vfloat vmax(vfloat a, vfloat b) { return {_mm256_max_ps(a.v, b.v)}; }
+  inline vfloat vabs(vfloat a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v)}; }
+  // a > b ? x : y
+  inline vfloat select_gt(vfloat a, vfloat b, vfloat x, vfloat y)
+  {
+    return {_mm256_blendv_ps(y.v, x.v, _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ))};
+  }
+#elif defined(STEER_SSE)
+  struct vfloat { __m128 v; };
+  constexpr size_t lanes = 4;
+  inline vfloat load(const float *p, vfloat) { return {_mm_loadu_ps(p)}; }
+  inline void store(float *p, vfloat a) { _mm_storeu_ps(p, a.v); }
+  inline vfloat splat(float a, vfloat) { return {_mm_set1_ps(a)}; }
+  inline vfloat operator+(vfloat a, vfloat b) { return {_mm_add_ps(a.v, b.v)}; }
+  inline vfloat operator-(vfloat a, vfloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+  inline vfloat operator*(vfloat a, vfloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+  inline vfloat operator/(vfloat a, vfloat b) { return {_mm_div_ps(a.v, b.v)}; }
+  inline vfloat vsqrt(vfloat a) { return {_mm_sqrt_ps(a.v)}; }
+  inline vfloat vmin(vfloat a, vfloat b) { return {_mm_min_ps(a.v, b.v)}; }
+  inline vfloat vmax(vfloat a, vfloat b) { return {_mm_max_ps(a.v, b.v)}; }
+  inline vfloat vabs(vfloat a) { return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)}; }
+  inline vfloat select_gt(vfloat a, vfloat b, vfloat x, vfloat y)
+  {
+    const __m128 mask = _mm_cmpgt_ps(a.v, b.v);
+    return {_mm_or_ps(_mm_and_ps(mask, x.v), _mm_andnot_ps(mask, y.v))};
+  }
+#else
+  using vfloat = float;
+  constexpr size_t lanes = 1;
+#endif
+
+  inline float load(const float *p, float) { return *p; }
+  inline void store(float *p, float a) { *p = a; }
+  inline float splat(float a, float) { return a; }
+  inline float vsqrt(float a) { return sqrtf(a); }
+  inline float vmin(float a, float b) { return std::min(a, b); }
+  inline float vmax(float a, float b) { return std::max(a, b); }
+  inline float vabs(float a) { return fabsf(a); }
+  inline float select_gt(float a, float b, float x, float y) { return a > b ? x : y; }
+
+  // same math as safeinv/normalize/truncate in ecsTypes.h
+  template<typename V>
+  inline V safeinv(V v)
+  {
+    return select_gt(vabs(v), splat(1e-7f, V{}), splat(1.f, V{}) / v, v);
+  }
+
+  template<typename V>
+  inline void normalize(V &x, V &y)
+  {
+    const V inv = safeinv(vsqrt(x * x + y * y));
+    x = x * inv;
+    y = y * inv;
+  }
+
+  template<typename V>
+  inline void truncate(V &x, V &y, V len)
+  {
+    const V l = vsqrt(x * x + y * y);
+    const V scale = select_gt(l, len, len / l, splat(1.f, V{}));
+    x = x * scale;
+    y = y * scale;
+  }
+
+  // sd += normalize(dir) * speed - vel
+  template<typename V>
+  inline void steer_towards(SteerSoA &s, size_t i, V dirX, V dirY)
+  {
+    normalize(dirX, dirY);
+    const V speed = load(&s.speed[i], V{});
+    const V sdx = load(&s.sdx[i], V{}) + dirX * speed - load(&s.vx[i], V{});
+    const V sdy = load(&s.sdy[i], V{}) + dirY * speed - load(&s.vy[i], V{});
+    store(&s.sdx[i], sdx);
+    store(&s.sdy[i], sdy);
+  }
+
+  template<typename V>
+  inline void seek_lanes(SteerSoA &s, size_t i, float tx, float ty, float sign)
+  {
+    const V dirX = (splat(tx, V{}) - load(&s.px[i], V{})) * splat(sign, V{});
+    const V dirY = (splat(ty, V{}) - load(&s.py[i], V{})) * splat(sign, V{});
+    steer_towards(s, i, dirX, dirY);
+  }
+
+  template<typename V>
+  inline void evade_lanes(SteerSoA &s, size_t i, const Position &target, const Velocity &target_vel)
+  {
+    constexpr float maxPredictTime = 4.f;
+    const V px = load(&s.px[i], V{});
+    const V py = load(&s.py[i], V{});
+    const V vx = load(&s.vx[i], V{});
+    const V vy = load(&s.vy[i], V{});
+    const V dposX = px - splat(target.x, V{});
+    const V dposY = py - splat(target.y, V{});
+    const V dist = vsqrt(dposX * dposX + dposY * dposY);
+    const V dvelX = vx - splat(target_vel.x, V{});
+    const V dvelY = vy - splat(target_vel.y, V{});
+    const V dotProduct = (dvelX * dposX + dvelY * dposY) * safeinv(dist);
+    const V interceptTime = dotProduct * safeinv(vsqrt(dvelX * dvelX + dvelY * dvelY));
+    const V predictTime = vmax(vmin(splat(maxPredictTime, V{}), interceptTime * splat(0.9f, V{})), splat(1.f, V{}));
+    const V targetX = splat(target.x, V{}) + splat(target_vel.x, V{}) * predictTime;
+    const V targetY = splat(target.y, V{}) + splat(target_vel.y, V{}) * predictTime;
+    steer_towards(s, i, px - targetX, py - targetY);
+  }
+
+  template<typename V>
+  inline void integrate_lanes(SteerSoA &s, size_t i, float dt)
+  {
+    const V speed = load(&s.speed[i], V{});
+    V sdx = load(&s.sdx[i], V{});
+    V sdy = load(&s.sdy[i], V{});
+    truncate(sdx, sdy, speed);
+    const V mult = splat(dt, V{}) * load(&s.accel[i], V{});
+    V vx = load(&s.vx[i], V{}) + sdx * mult;
+    V vy = load(&s.vy[i], V{}) + sdy * mult;
+    truncate(vx, vy, speed);
+    store(&s.vx[i], vx);
+    store(&s.vy[i], vy);
+  }
+
+  template<typename Kernel>
+  inline void for_lanes(size_t begin, size_t end, Kernel k)
+  {
+    size_t i = begin;
+    for (; i + lanes <= end; i += lanes)
+      k(i, vfloat{});
+    for (; i < end; ++i)
+      k(i, 0.f);
+  }
+}
+
+void SteerSoA::clear()
+{
+  px.clear(); py.clear();
+  vx.clear(); vy.clear();
+  speed.clear();
+  accel.clear();
+  sdx.clear(); sdy.clear();
+  velocity.clear();
+  steerDir.clear();
+}
+
+void SteerSoA::push(const Position &pos, Velocity &vel, float move_speed, float steer_accel, SteerDir &sd)
+{
+  px.push_back(pos.x); py.push_back(pos.y);
+  vx.push_back(vel.x); vy.push_back(vel.y);
+  speed.push_back(move_speed);
+  accel.push_back(steer_accel);
+  sdx.push_back(sd.x); sdy.push_back(sd.y);
+  velocity.push_back(&vel);
+  steerDir.push_back(&sd);
+}
+
+void SteerSoA::write_back(size_t begin, size_t end) const
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    *velocity[i] = Velocity{vx[i], vy[i]};
+    *steerDir[i] = SteerDir{sdx[i], sdy[i]};
+  }
+}
+
+void steer::batch_seek(SteerSoA &soa, size_t begin, size_t end, const Position &target)
+{
+  for_lanes(begin, end, [&](size_t i, auto v) { seek_lanes<decltype(v)>(soa, i, target.x, target.y, 1.f); });
+}
+
+void steer::batch_flee(SteerSoA &soa, size_t begin, size_t end, const Position &target)
+{
+  for_lanes(begin, end, [&](size_t i, auto v) { seek_lanes<decltype(v)>(soa, i, target.x, target.y, -1.f); });
+}
+
+void steer::batch_pursue(SteerSoA &soa, size_t begin, size_t end, const Position &target, const Velocity &target_vel)
+{
+  constexpr float predictTime = 4.f;
+  const Position targetPos = target + target_vel * predictTime;
+  batch_seek(soa, begin, end, targetPos);
+}
+
+void steer::batch_evade(SteerSoA &soa, size_t begin, size_t end, const Position &target, const Velocity &target_vel)
+{
+  for_lanes(begin, end, [&](size_t i, auto v) { evade_lanes<decltype(v)>(soa, i, target, target_vel); });
+}
+
+void steer::batch_integrate_velocity(SteerSoA &soa, size_t begin, size_t end, float dt)
+{
+  for_lanes(begin, end, [&](size_t i, auto v) { integrate_lanes<decltype(v)>(soa, i, dt); });
+}
+
+size_t steer::batch_lanes()
+{
+  return lanes;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+
+// Structure of arrays copy of the steering state, gathered from ecs once per frame
+// so that batch kernels can process several agents per instruction.
+struct SteerSoA
+{
+  std::vector<float> px, py;
+  std::vector<float> vx, vy;
+  std::vector<float> speed;
+  std::vector<float> accel;
+  std::vector<float> sdx, sdy;
+  // where to write results back
+  std::vector<Velocity*> velocity;
+  std::vector<SteerDir*> steerDir;
+
+  size_t size() const { return px.size(); }
+  void clear();
+  void push(const Position &pos, Velocity &vel, float move_speed, float steer_accel, SteerDir &sd);
+  void write_back(size_t begin, size_t end) const;
+};
+
+namespace steer
+{
+  // all kernels work on agents [begin, end) and accumulate into sdx/sdy like the scalar systems
+  void batch_seek(SteerSoA &soa, size_t begin, size_t end, const Position &target);
+  void batch_flee(SteerSoA &soa, size_t begin, size_t end, const Position &target);
+  void batch_pursue(SteerSoA &soa, size_t begin, size_t end, const Position &target, const Velocity &target_vel);
+  void batch_evade(SteerSoA &soa, size_t begin, size_t end, const Position &target, const Velocity &target_vel);
+  // vel = truncate(vel + truncate(sd, speed) * dt * accel, speed)
+  void batch_integrate_velocity(SteerSoA &soa, size_t begin, size_t end, float dt);
+
+  // width of the vector path the kernels were compiled with, 1 when there's none
+  size_t batch_lanes();
+};
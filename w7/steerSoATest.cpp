@@ -0,0 +1,138 @@
+// Checks the batch steering kernels against the scalar steering they replaced: normalize/truncate
+// from ecsTypes.h and the seek, flee, pursue and evade formulas of the old per-agent systems.
+// Run by ctest, exits with 1 when any result differs by more than the tolerance.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "ecsTypes.h"
+#include "steerSoA.h"
+
+namespace
+{
+  // the old per-agent systems, one agent at a time
+  void seek(SteerDir &sd, const Position &p, const Velocity &vel, float speed, const Position &target)
+  {
+    sd += SteerDir{normalize(target - p) * speed - vel};
+  }
+
+  void flee(SteerDir &sd, const Position &p, const Velocity &vel, float speed, const Position &target)
+  {
+    sd += SteerDir{normalize(p - target) * speed - vel};
+  }
+
+  void pursue(SteerDir &sd, const Position &p, const Velocity &vel, float speed,
+              const Position &target, const Velocity &target_vel)
+  {
+    constexpr float predictTime = 4.f;
+    const Position targetPos = target + target_vel * predictTime;
+    sd += SteerDir{normalize(targetPos - p) * speed - vel};
+  }
+
+  void evade(SteerDir &sd, const Position &p, const Velocity &vel, float speed,
+             const Position &target, const Velocity &target_vel)
+  {
+    constexpr float maxPredictTime = 4.f;
+    const Position dpos = p - target;
+    const float dist = length(dpos);
+    const Position dvel = vel - target_vel;
+    const float dotProduct = (dvel.x * dpos.x + dvel.y * dpos.y) * safeinv(dist);
+    const float interceptTime = dotProduct * safeinv(length(dvel));
+    const float predictTime = std::max(std::min(maxPredictTime, interceptTime * 0.9f), 1.f);
+    const Position targetPos = target + target_vel * predictTime;
+    sd += SteerDir{normalize(p - targetPos) * speed - vel};
+  }
+
+  void integrate_velocity(Velocity &vel, const SteerDir &sd, float speed, float accel, float dt)
+  {
+    vel = Velocity{truncate(vel + truncate(sd, speed) * dt * accel, speed)};
+  }
+
+  struct Agent
+  {
+    Position pos;
+    Velocity vel;
+    SteerDir sd;
+    float speed;
+    float accel;
+  };
+
+  float relative_error(float got, float want)
+  {
+    return fabsf(got - want) / std::max(1.f, fabsf(want));
+  }
+}
+
+int main()
+{
+  constexpr float tolerance = 1e-4f;
+  // not a multiple of any lane count, so the scalar tail of the kernels runs too
+  constexpr size_t agentCount = 1027;
+  constexpr float dt = 1.f / 60.f;
+  const Position target{0.f, 0.f};
+  const Velocity targetVel{30.f, -20.f};
+
+  std::default_random_engine rng(1);
+  std::uniform_real_distribution<float> coord(-2000.f, 2000.f);
+  std::uniform_real_distribution<float> speed(50.f, 300.f);
+  std::uniform_real_distribution<float> accel(0.5f, 2.f);
+  std::vector<Agent> agents(agentCount);
+  for (Agent &a : agents)
+  {
+    a.pos = Position{coord(rng), coord(rng)};
+    a.vel = Velocity{coord(rng) * 0.1f, coord(rng) * 0.1f};
+    a.sd = SteerDir{coord(rng) * 0.1f, coord(rng) * 0.1f};
+    a.speed = speed(rng);
+    a.accel = accel(rng);
+  }
+  // a standing agent, one right on the target and one moving with it hit the safeinv branches
+  agents[0].vel = Velocity{0.f, 0.f};
+  agents[1].pos = target;
+  agents[2].vel = targetVel;
+
+  std::vector<Agent> scalar = agents;
+  SteerSoA batch;
+  for (Agent &a : agents)
+    batch.push(a.pos, a.vel, a.speed, a.accel, a.sd);
+
+  int failures = 0;
+  auto compare = [&](const char *kernel)
+  {
+    float maxError = 0.f;
+    for (size_t i = 0; i < agentCount; ++i)
+    {
+      maxError = std::max(maxError, relative_error(batch.sdx[i], scalar[i].sd.x));
+      maxError = std::max(maxError, relative_error(batch.sdy[i], scalar[i].sd.y));
+      maxError = std::max(maxError, relative_error(batch.vx[i], scalar[i].vel.x));
+      maxError = std::max(maxError, relative_error(batch.vy[i], scalar[i].vel.y));
+    }
+    const bool ok = maxError <= tolerance;
+    printf("%-18s max relative error %g%s\n", kernel, double(maxError), ok ? "" : " FAILED");
+    failures += ok ? 0 : 1;
+  };
+
+  printf("steering kernels: %zu lanes\n", steer::batch_lanes());
+  steer::batch_seek(batch, 0, agentCount, target);
+  for (Agent &a : scalar)
+    seek(a.sd, a.pos, a.vel, a.speed, target);
+  compare("seek");
+  steer::batch_flee(batch, 0, agentCount, target);
+  for (Agent &a : scalar)
+    flee(a.sd, a.pos, a.vel, a.speed, target);
+  compare("flee");
+  steer::batch_pursue(batch, 0, agentCount, target, targetVel);
+  for (Agent &a : scalar)
+    pursue(a.sd, a.pos, a.vel, a.speed, target, targetVel);
+  compare("pursue");
+  steer::batch_evade(batch, 0, agentCount, target, targetVel);
+  for (Agent &a : scalar)
+    evade(a.sd, a.pos, a.vel, a.speed, target, targetVel);
+  compare("evade");
+  steer::batch_integrate_velocity(batch, 0, agentCount, dt);
+  for (Agent &a : scalar)
+    integrate_velocity(a.vel, a.sd, a.speed, a.accel, dt);
+  compare("integrate_velocity");
+  return failures == 0 ? 0 : 1;
+}
@@ -1,5 +1,7 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "spatialGrid.h"
+#include "steerSoA.h"
 
 struct Seeker {};
 struct Pursuer {};
@@ -55,6 +57,44 @@ flecs::entity steer::create_fleer(flecs::entity e)
   return create_steerer(e).add<Fleer>();
 }
 
+// Read-only copy of the steering target, taken once per frame before the worker threads start,
+// so parallel systems never run nested queries.
+struct SteerSnapshot
+{
+  Position playerPos;
+  Velocity playerVel;
+  bool hasPlayer = false;
+};
+
+// every worker mirrors the chunk of agents it was handed into its own arrays
+static SteerSoA &gather_chunk(flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms,
+                              SteerDir *sd, const SteerAccel *sa)
+{
+  static thread_local SteerSoA soa;
+  soa.clear();
+  for (auto i : it)
+    soa.push(pos[i], vel[i], ms[i].speed, sa[i].accel, sd[i]);
+  return soa;
+}
+
+// registers a parallel system running batch kernel k over every chunk of agents tagged Tag
+template<typename Tag, typename Kernel>
+static void register_batch_behaviour(flecs::world &ecs, Kernel k)
+{
+  ecs.system<const Position, Velocity, const MoveSpeed, SteerDir, const SteerAccel>()
+    .template term<Tag>()
+    .multi_threaded()
+    .iter([k](flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms, SteerDir *sd, const SteerAccel *sa)
+    {
+      const SteerSnapshot *snap = it.world().get<SteerSnapshot>();
+      if (!snap->hasPlayer)
+        return;
+      SteerSoA &soa = gather_chunk(it, pos, vel, ms, sd, sa);
+      k(soa, *snap);
+      soa.write_back(0, soa.size());
+    });
+}
+
 typedef flecs::entity (*create_foo)(flecs::entity);
 
 flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
@@ -72,128 +112,111 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
 
 void steer::register_systems(flecs::world &ecs)
 {
-  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
-
-  ecs.system<Velocity, const MoveSpeed, const SteerDir, const SteerAccel>()
-    .each([&](Velocity &vel, const MoveSpeed &ms, const SteerDir &sd, const SteerAccel &sa)
+  // Systems marked multi_threaded are split between flecs worker threads. They only touch
+  // their own agent's components and read shared data from the snapshot or the grid.
+  ecs.set<SteerSnapshot>({});
+  ecs.system<SteerSnapshot>()
+    .each([&](SteerSnapshot &snap)
     {
-      vel = Velocity{truncate(vel + truncate(sd, ms.speed) * ecs.delta_time() * sa.accel, ms.speed)};
-    });
-
-  // reset steer dir
-  ecs.system<SteerDir>().each([&](SteerDir &sd) { sd = {0.f, 0.f}; });
-
-  // seeker
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Seeker>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel,
-              const Position &p, const Seeker &)
-    {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
+      snap = SteerSnapshot{};
+      ecs.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
       {
-        sd += SteerDir{normalize(pp - p) * ms.speed - vel};
+        snap.playerPos = pp;
+        snap.playerVel = pvel;
+        snap.hasPlayer = true;
       });
     });
 
-  // fleer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Fleer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Fleer &)
+  // steering state is mirrored into SoA arrays so kernels process several agents at once
+  ecs.system<const Position, Velocity, const MoveSpeed, SteerDir, const SteerAccel>()
+    .multi_threaded()
+    .iter([](flecs::iter &it, const Position *pos, Velocity *vel, const MoveSpeed *ms, SteerDir *sd, const SteerAccel *sa)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
-      {
-        sd += SteerDir{normalize(p - pp) * ms.speed - vel};
-      });
+      SteerSoA &soa = gather_chunk(it, pos, vel, ms, sd, sa);
+      steer::batch_integrate_velocity(soa, 0, soa.size(), it.delta_time());
+      soa.write_back(0, soa.size());
     });
 
-  // pursuer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Pursuer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Pursuer &)
-    {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
-      {
-        constexpr float predictTime = 4.f;
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(targetPos - p) * ms.speed - vel};
-      });
-    });
-
-  // evader
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Evader>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Evader &)
-    {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel,
-                              const IsPlayer &)
-      {
-        constexpr float maxPredictTime = 4.f;
-        const Position dpos = p - pp;
-        const float dist = length(dpos);
-        const Position dvel = vel - pvel;
-        const float dotProduct = (dvel.x * dpos.x + dvel.y * dpos.y) * safeinv(dist);
-        const float interceptTime = dotProduct * safeinv(length(dvel));
-        const float predictTime = std::max(std::min(maxPredictTime, interceptTime * 0.9f), 1.f);
-
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(p - targetPos) * ms.speed - vel};
-      });
-    });
-
-  static auto otherPosQuery = ecs.query<const Position, const Hitpoints>();
+  // reset steer dir
+  ecs.system<SteerDir>().multi_threaded().each([](SteerDir &sd) { sd = {0.f, 0.f}; });
 
-  // separation is expensive!!!
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Separation>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Separation &)
-    {
-      otherPosQuery.each([&](flecs::entity oe, const Position &op, const Hitpoints &)
-      {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 70.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{(p - op) * safeinv(distSq) * ms.speed * thresDist - vel};
-      });
-    });
+  register_batch_behaviour<Seeker>(ecs, [](SteerSoA &soa, const SteerSnapshot &snap)
+  {
+    steer::batch_seek(soa, 0, soa.size(), snap.playerPos);
+  });
+  register_batch_behaviour<Fleer>(ecs, [](SteerSoA &soa, const SteerSnapshot &snap)
+  {
+    steer::batch_flee(soa, 0, soa.size(), snap.playerPos);
+  });
+  register_batch_behaviour<Pursuer>(ecs, [](SteerSoA &soa, const SteerSnapshot &snap)
+  {
+    steer::batch_pursue(soa, 0, soa.size(), snap.playerPos, snap.playerVel);
+  });
+  register_batch_behaviour<Evader>(ecs, [](SteerSoA &soa, const SteerSnapshot &snap)
+  {
+    steer::batch_evade(soa, 0, soa.size(), snap.playerPos, snap.playerVel);
+  });
 
-  static auto otherVelQuery = ecs.query<const Position, const Velocity>();
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Alignment>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Alignment &)
+  // neighbour queries only visit nearby grid cells instead of every entity
+  ecs.set<SpatialGrid>({});
+  ecs.system<SpatialGrid>()
+    .each([&](SpatialGrid &grid)
     {
-      otherVelQuery.each([&](flecs::entity oe, const Position &op, const Velocity &ovel)
-      {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 100.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{ovel * 0.8f};
-      });
+      rebuild_spatial_grid(ecs, grid);
     });
 
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Cohesion>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Cohesion &)
+  // flocking: separation, alignment and cohesion share one walk over the neighbours,
+  // behaviours an agent doesn't have are masked out. The behaviour tags are optional terms, so
+  // which of them an agent has is resolved once per table.
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position>()
+    .term<Separation>().optional()
+    .term<Alignment>().optional()
+    .term<Cohesion>().optional()
+    .multi_threaded()
+    .iter([](flecs::iter &it, SteerDir *sd, const Velocity *vel, const MoveSpeed *ms, const Position *pos)
     {
-      Position avgPos{0.f, 0.f};
-      size_t count = 0;
-      otherPosQuery.each([&](flecs::entity oe, const Position &op, const Hitpoints &)
+      const bool separation = it.is_set(5);
+      const bool alignment = it.is_set(6);
+      const bool cohesion = it.is_set(7);
+      if (!separation && !alignment && !cohesion)
+        return;
+      constexpr float separationDist = 70.f;
+      constexpr float alignmentDist = 100.f;
+      constexpr float cohesionDist = 500.f;
+      const float radius = cohesion ? cohesionDist : alignment ? alignmentDist : separationDist;
+      const float separationDistSq = separation ? separationDist * separationDist : -1.f;
+      const float alignmentDistSq = alignment ? alignmentDist * alignmentDist : -1.f;
+      const float cohesionDistSq = cohesion ? cohesionDist * cohesionDist : -1.f;
+      const SpatialGrid *grid = it.world().get<SpatialGrid>();
+
+      for (auto i : it)
       {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 500.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        count++;
-        avgPos += op;
-      });
-      constexpr float avgPosMult = 100.f;
-      sd += SteerDir{normalize(avgPos * safeinv(float(count)) - p) * avgPosMult - vel};
+        const flecs::entity ent = it.entity(i);
+        const Position &p = pos[i];
+        Position separationDir{0.f, 0.f};
+        Position alignmentDir{0.f, 0.f};
+        Position avgPos{0.f, 0.f};
+        float count = 0.f;
+        grid->each_in_radius(p, radius, [&](const SpatialGrid::Item &other)
+        {
+          if (other.entity == ent)
+            return;
+          const float distSq = length_sq(other.pos - p);
+          const float separationMask = distSq <= separationDistSq ? 1.f : 0.f;
+          const float alignmentMask = distSq <= alignmentDistSq ? 1.f : 0.f;
+          const float cohesionMask = distSq <= cohesionDistSq ? 1.f : 0.f;
+          separationDir += ((p - other.pos) * safeinv(distSq) * ms[i].speed * separationDist - vel[i]) * separationMask;
+          alignmentDir += other.vel * (0.8f * alignmentMask);
+          avgPos += other.pos * cohesionMask;
+          count += cohesionMask;
+        });
+        sd[i] += SteerDir{separationDir + alignmentDir};
+        if (cohesion)
+        {
+          constexpr float avgPosMult = 100.f;
+          sd[i] += SteerDir{normalize(avgPos * safeinv(count) - p) * avgPosMult - vel[i]};
+        }
+      }
     });
 
 }
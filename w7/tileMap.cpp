@@ -0,0 +1,63 @@
+#include "tileMap.h"
+#include <algorithm>
+#include "dungeonUtils.h"
+
+TileMap bake_tile_map(const char *tiles, size_t w, size_t h, float tile_size, const SpriteAtlas &atlas,
+                      const SpriteRegion &wall, const SpriteRegion &floor)
+{
+  TileMap tileMap;
+  for (size_t cy = 0; cy < h; cy += TileMap::chunk_size)
+    for (size_t cx = 0; cx < w; cx += TileMap::chunk_size)
+    {
+      const size_t cw = std::min(TileMap::chunk_size, w - cx);
+      const size_t ch = std::min(TileMap::chunk_size, h - cy);
+      TileMap::Chunk chunk;
+      chunk.bounds = Rectangle{cx * tile_size, cy * tile_size, cw * tile_size, ch * tile_size};
+      chunk.target = LoadRenderTexture(int(cw) * TileMap::texels_per_tile, int(ch) * TileMap::texels_per_tile);
+      SetTextureFilter(chunk.target.texture, TEXTURE_FILTER_BILINEAR);
+      BeginTextureMode(chunk.target);
+        ClearBackground(BLANK);
+        for (size_t y = 0; y < ch; ++y)
+          for (size_t x = 0; x < cw; ++x)
+          {
+            const char tile = tiles[(cy + y) * w + cx + x];
+            if (tile != dungeon::wall && tile != dungeon::floor)
+              continue;
+            const SpriteRegion &region = tile == dungeon::wall ? wall : floor;
+            DrawTexturePro(atlas.pages[region.page], region.rect,
+                           Rectangle{float(x * TileMap::texels_per_tile), float(y * TileMap::texels_per_tile),
+                                     float(TileMap::texels_per_tile), float(TileMap::texels_per_tile)},
+                           Vector2{0.f, 0.f}, 0.f, WHITE);
+          }
+      EndTextureMode();
+      tileMap.chunks.push_back(chunk);
+    }
+  return tileMap;
+}
+
+void set_tile_map(flecs::world &ecs, const TileMap &tile_map)
+{
+  ecs.observer<TileMap>()
+    .event(flecs::OnRemove)
+    .each([](TileMap &map)
+    {
+      for (const TileMap::Chunk &chunk : map.chunks)
+        UnloadRenderTexture(chunk.target);
+      map.chunks.clear();
+    });
+  ecs.set<TileMap>(tile_map);
+}
+
+void draw_tile_chunk(const TileMap::Chunk &chunk)
+{
+  // render textures are stored upside down, and at texels_per_tile they're scaled up to the tile size
+  const Texture2D &tex = chunk.target.texture;
+  const Rectangle src{0.f, 0.f, float(tex.width), -float(tex.height)};
+  DrawTexturePro(tex, src, chunk.bounds, Vector2{0.f, 0.f}, 0.f, WHITE);
+}
+
+void draw_tile_map(const TileMap &tile_map)
+{
+  for (const TileMap::Chunk &chunk : tile_map.chunks)
+    draw_tile_chunk(chunk);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <raylib.h>
+#include <flecs.h>
+#include "spriteAtlas.h"
+
+// Dungeon background baked into render textures of chunk_size x chunk_size tiles,
+// replaces an entity and a draw call per tile with a draw call per chunk.
+struct TileMap
+{
+  static constexpr size_t chunk_size = 32;
+  // baked below the 512px source art and drawn scaled up, keeps a chunk target at 1 MB
+  static constexpr int texels_per_tile = 16;
+
+  struct Chunk
+  {
+    Rectangle bounds; // in world coordinates
+    RenderTexture2D target;
+  };
+  std::vector<Chunk> chunks;
+};
+
+TileMap bake_tile_map(const char *tiles, size_t w, size_t h, float tile_size, const SpriteAtlas &atlas,
+                      const SpriteRegion &wall, const SpriteRegion &floor);
+// sets the TileMap singleton, its render textures are unloaded when it's removed from the world
+void set_tile_map(flecs::world &ecs, const TileMap &tile_map);
+void draw_tile_map(const TileMap &tile_map);
+void draw_tile_chunk(const TileMap::Chunk &chunk);